@@ -0,0 +1,159 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+// Compares media::LRU with the std::list and hash_map LRU it replaced, in
+// operations per second and heap allocations, on the access pattern of the
+// block caches: reads of cached blocks, and new blocks evicting the oldest.
+//
+// Usage: ./lru_benchmark [--blocks=4096] [--ops=10000000]
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <list>
+#include <string>
+
+#include "base/allocator/features.h"
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/containers/hash_tables.h"
+#include "base/debug/thread_heap_usage_tracker.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/time/time.h"
+#include "chromium_media_lib/lru.h"
+
+namespace {
+
+// media::LRU before it was made allocation free.
+template <typename T>
+class ListLRU {
+ public:
+  ListLRU() {}
+
+  void Insert(const T& x) {
+    DCHECK(!Contains(x));
+    lru_.push_front(x);
+    pos_[x] = lru_.begin();
+  }
+
+  void Remove(const T& x) {
+    DCHECK(Contains(x));
+    lru_.erase(pos_[x]);
+    pos_.erase(x);
+  }
+
+  void Use(const T& x) {
+    if (Contains(x))
+      Remove(x);
+    Insert(x);
+  }
+
+  T Pop() {
+    T ret = lru_.back();
+    lru_.pop_back();
+    pos_.erase(ret);
+    return ret;
+  }
+
+  bool Contains(const T& x) const { return pos_.find(x) != pos_.end(); }
+
+ private:
+  std::list<T> lru_;
+  base::hash_map<T, typename std::list<T>::iterator> pos_;
+
+  DISALLOW_COPY_AND_ASSIGN(ListLRU);
+};
+
+// Deterministic, so that both LRUs see the same operations.
+class Random {
+ public:
+  Random() : state_(0x2545f4914f6cdd1dULL) {}
+
+  uint64_t Next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 7;
+    state_ ^= state_ << 17;
+    return state_;
+  }
+
+ private:
+  uint64_t state_;
+};
+
+struct Result {
+  double ops_per_second;
+  // -1 when the build can't count allocations.
+  int64_t allocations;
+};
+
+// Fills the LRU with |blocks| blocks, then runs |ops| operations: 3 of 4
+// read a cached block, the others add a block and evict the oldest.
+template <typename LRUType>
+Result Run(int64_t blocks, int64_t ops) {
+  LRUType lru;
+  for (int64_t id = 0; id < blocks; ++id)
+    lru.Insert(id);
+  int64_t next_id = blocks;
+  Random random;
+
+#if BUILDFLAG(USE_ALLOCATOR_SHIM)
+  base::debug::ThreadHeapUsageTracker tracker;
+  tracker.Start();
+#endif
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int64_t i = 0; i < ops; ++i) {
+    uint64_t r = random.Next();
+    if (r & 3) {
+      // Most reads are of recent blocks, near the end of the ids.
+      lru.Use(next_id - 1 - static_cast<int64_t>((r >> 2) % blocks));
+    } else {
+      lru.Insert(next_id++);
+      lru.Pop();
+    }
+  }
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  Result result;
+  result.ops_per_second = ops / elapsed.InSecondsF();
+  result.allocations = -1;
+#if BUILDFLAG(USE_ALLOCATOR_SHIM)
+  tracker.Stop(false);
+  result.allocations = static_cast<int64_t>(tracker.usage().alloc_ops);
+#endif
+  return result;
+}
+
+void Print(const char* name, const Result& result) {
+  std::string allocations = result.allocations < 0
+                                ? "n/a"
+                                : base::Int64ToString(result.allocations);
+  printf("%-12s %14.0f ops/s %14s allocations\n", name,
+         result.ops_per_second, allocations.c_str());
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+  base::AtExitManager at_exit;
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* command_line = base::CommandLine::ForCurrentProcess();
+
+  int64_t blocks = 4096;
+  int64_t ops = 10000000;
+  if (command_line->HasSwitch("blocks"))
+    base::StringToInt64(command_line->GetSwitchValueASCII("blocks"), &blocks);
+  if (command_line->HasSwitch("ops"))
+    base::StringToInt64(command_line->GetSwitchValueASCII("ops"), &ops);
+  if (blocks <= 0 || ops <= 0) {
+    LOG(ERROR) << "Usage:\n ./lru_benchmark [--blocks=N] [--ops=N]";
+    return 1;
+  }
+
+#if BUILDFLAG(USE_ALLOCATOR_SHIM)
+  base::debug::ThreadHeapUsageTracker::EnableHeapTracking();
+#endif
+  Print("list+hash", Run<ListLRU<int64_t>>(blocks, ops));
+  Print("LRU", Run<media::LRU<int64_t>>(blocks, ops));
+  return 0;
+}
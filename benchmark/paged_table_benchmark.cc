@@ -0,0 +1,158 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+// Compares media::PagedTable with the std::map it replaced as the block
+// index of ResourceBlockCache, in operations per second and heap
+// allocations. A writer appends blocks and the oldest are evicted to keep
+// |blocks| cached, while a reader looks blocks up in order and seeks to a
+// random cached block now and then.
+//
+// Usage: ./paged_table_benchmark [--blocks=4096] [--ops=10000000]
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <string>
+
+#include "base/allocator/features.h"
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/debug/thread_heap_usage_tracker.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/time/time.h"
+#include "chromium_media_lib/paged_table.h"
+
+namespace {
+
+// Reads between seeks of the reader.
+const int kReadsPerSeek = 256;
+
+// The std::map index, with the PagedTable interface.
+class MapTable {
+ public:
+  MapTable() {}
+
+  int64_t* Find(int64_t index) {
+    auto found = map_.find(index);
+    return found == map_.end() ? nullptr : &found->second;
+  }
+
+  void Insert(int64_t index, int64_t value) { map_[index] = value; }
+
+  int64_t Take(int64_t index) {
+    auto found = map_.find(index);
+    int64_t value = found->second;
+    map_.erase(found);
+    return value;
+  }
+
+ private:
+  std::map<int64_t, int64_t> map_;
+
+  DISALLOW_COPY_AND_ASSIGN(MapTable);
+};
+
+// Deterministic, so that both tables see the same operations.
+class Random {
+ public:
+  Random() : state_(0x2545f4914f6cdd1dULL) {}
+
+  uint64_t Next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 7;
+    state_ ^= state_ << 17;
+    return state_;
+  }
+
+ private:
+  uint64_t state_;
+};
+
+struct Result {
+  double ops_per_second;
+  // -1 when the build can't count allocations.
+  int64_t allocations;
+};
+
+// Runs |ops| operations, one of 4 writes a block and evicts the oldest,
+// the others are lookups of the reader.
+template <typename Table>
+Result Run(int64_t blocks, int64_t ops) {
+  Table table;
+  for (int64_t id = 0; id < blocks; ++id)
+    table.Insert(id, id);
+  int64_t oldest = 0;
+  int64_t next_id = blocks;
+  int64_t reader = 0;
+  int64_t sum = 0;
+  Random random;
+
+#if BUILDFLAG(USE_ALLOCATOR_SHIM)
+  base::debug::ThreadHeapUsageTracker tracker;
+  tracker.Start();
+#endif
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int64_t i = 0; i < ops; ++i) {
+    if (!(i & 3)) {
+      table.Insert(next_id, next_id);
+      ++next_id;
+      sum += table.Take(oldest++);
+      continue;
+    }
+    if (!(i % kReadsPerSeek) || reader < oldest || reader >= next_id) {
+      reader = oldest +
+               static_cast<int64_t>(random.Next() % (next_id - oldest));
+    }
+    int64_t* value = table.Find(reader++);
+    if (value)
+      sum += *value;
+  }
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  // Keeps the lookups from being optimized away.
+  CHECK_NE(sum, -1);
+
+  Result result;
+  result.ops_per_second = ops / elapsed.InSecondsF();
+  result.allocations = -1;
+#if BUILDFLAG(USE_ALLOCATOR_SHIM)
+  tracker.Stop(false);
+  result.allocations = static_cast<int64_t>(tracker.usage().alloc_ops);
+#endif
+  return result;
+}
+
+void Print(const char* name, const Result& result) {
+  std::string allocations = result.allocations < 0
+                                ? "n/a"
+                                : base::Int64ToString(result.allocations);
+  printf("%-12s %14.0f ops/s %14s allocations\n", name,
+         result.ops_per_second, allocations.c_str());
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+  base::AtExitManager at_exit;
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* command_line = base::CommandLine::ForCurrentProcess();
+
+  int64_t blocks = 4096;
+  int64_t ops = 10000000;
+  if (command_line->HasSwitch("blocks"))
+    base::StringToInt64(command_line->GetSwitchValueASCII("blocks"), &blocks);
+  if (command_line->HasSwitch("ops"))
+    base::StringToInt64(command_line->GetSwitchValueASCII("ops"), &ops);
+  if (blocks <= 0 || ops <= 0) {
+    LOG(ERROR) << "Usage:\n ./paged_table_benchmark [--blocks=N] [--ops=N]";
+    return 1;
+  }
+
+#if BUILDFLAG(USE_ALLOCATOR_SHIM)
+  base::debug::ThreadHeapUsageTracker::EnableHeapTracking();
+#endif
+  Print("std::map", Run<MapTable>(blocks, ops));
+  Print("PagedTable", Run<media::PagedTable<int64_t>>(blocks, ops));
+  return 0;
+}
@@ -0,0 +1,363 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+// Compares the single stream of ResourceMultiBuffer with parallel range
+// fetchers against a local HTTP server which limits the bandwidth of every
+// connection and stalls some responses. A reader plays the resource at
+// |bitrate| and reads up to |buffer-seconds| ahead. Reported are the time to
+// the first 64 KB and the time playback would have stalled.
+//
+// Usage: ./range_fetch_benchmark [--fetchers=4] [--connection-kbps=3000]
+//            [--bitrate=4000000] [--seconds=30] [--buffer-seconds=5]
+//            [--stall-every=8] [--stall-ms=2000]
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/memory/ptr_util.h"
+#include "base/memory/ref_counted.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/task_scheduler/task_scheduler.h"
+#include "base/threading/thread.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "base/time/time.h"
+#include "chromium_media_lib/media_context.h"
+#include "chromium_media_lib/resource_data_source.h"
+#include "net/http/http_byte_range.h"
+#include "net/http/http_util.h"
+#include "net/test/embedded_test_server/embedded_test_server.h"
+#include "net/test/embedded_test_server/http_request.h"
+#include "net/test/embedded_test_server/http_response.h"
+#include "url/gurl.h"
+
+namespace {
+
+// Bytes the server sends at once, and the reader asks for per read.
+const int kSendChunkBytes = 16 * 1024;
+const int kReadBytes = 64 * 1024;
+
+struct ServerConfig {
+  int64_t total_bytes;
+  int64_t connection_bits_per_second;
+  // Every |stall_every|th response pauses for |stall| before its body, 0
+  // for none.
+  int stall_every;
+  base::TimeDelta stall;
+};
+
+// Body of a response, sent in chunks paced to the connection bandwidth.
+// Outlives the HttpResponse, which is destroyed once SendResponse()
+// returned.
+class ThrottledBody : public base::RefCounted<ThrottledBody> {
+ public:
+  ThrottledBody(int64_t first, int64_t last, const ServerConfig& config)
+      : position_(first), last_(last), config_(config) {}
+
+  void SendNext(const net::test_server::SendBytesCallback& send,
+                const net::test_server::SendCompleteCallback& done) {
+    if (position_ > last_) {
+      done.Run();
+      return;
+    }
+    int size = static_cast<int>(
+        std::min<int64_t>(kSendChunkBytes, last_ - position_ + 1));
+    std::string data(size, 0);
+    for (int i = 0; i < size; ++i)
+      data[i] = static_cast<char>(position_ + i);
+    position_ += size;
+    base::TimeDelta delay = base::TimeDelta::FromMicroseconds(
+        size * 8 * base::Time::kMicrosecondsPerSecond /
+        config_.connection_bits_per_second);
+    // Sent, then the next chunk once the bandwidth allows it.
+    send.Run(data, base::Bind(&ThrottledBody::SendLater, this, send, done,
+                              delay));
+  }
+
+  void SendLater(const net::test_server::SendBytesCallback& send,
+                 const net::test_server::SendCompleteCallback& done,
+                 base::TimeDelta delay) {
+    base::ThreadTaskRunnerHandle::Get()->PostDelayedTask(
+        FROM_HERE, base::Bind(&ThrottledBody::SendNext, this, send, done),
+        delay);
+  }
+
+ private:
+  friend class base::RefCounted<ThrottledBody>;
+  ~ThrottledBody() {}
+
+  int64_t position_;
+  const int64_t last_;
+  const ServerConfig config_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThrottledBody);
+};
+
+class ThrottledResponse : public net::test_server::HttpResponse {
+ public:
+  ThrottledResponse(int64_t first,
+                    int64_t last,
+                    bool stall,
+                    const ServerConfig& config)
+      : first_(first), last_(last), stall_(stall), config_(config) {}
+
+  void SendResponse(
+      const net::test_server::SendBytesCallback& send,
+      const net::test_server::SendCompleteCallback& done) override {
+    std::string headers = base::StringPrintf(
+        "HTTP/1.1 206 Partial Content\r\n"
+        "Accept-Ranges: bytes\r\n"
+        "Content-Range: bytes %" PRId64 "-%" PRId64 "/%" PRId64 "\r\n"
+        "Content-Length: %" PRId64 "\r\n"
+        "Content-Type: application/octet-stream\r\n\r\n",
+        first_, last_, config_.total_bytes, last_ - first_ + 1);
+    scoped_refptr<ThrottledBody> body =
+        new ThrottledBody(first_, last_, config_);
+    send.Run(headers,
+             base::Bind(&ThrottledBody::SendLater, body, send, done,
+                        stall_ ? config_.stall : base::TimeDelta()));
+  }
+
+ private:
+  const int64_t first_;
+  const int64_t last_;
+  const bool stall_;
+  const ServerConfig config_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThrottledResponse);
+};
+
+// Runs on the server thread.
+std::unique_ptr<net::test_server::HttpResponse> HandleRequest(
+    const ServerConfig& config,
+    int* responses,
+    const net::test_server::HttpRequest& request) {
+  if (request.GetURL().path() != "/media")
+    return nullptr;
+  int64_t first = 0;
+  int64_t last = config.total_bytes - 1;
+  std::vector<net::HttpByteRange> ranges;
+  auto range_header = request.headers.find("Range");
+  if (range_header != request.headers.end() &&
+      net::HttpUtil::ParseRangeHeader(range_header->second, &ranges) &&
+      ranges.size() == 1 && ranges[0].ComputeBounds(config.total_bytes)) {
+    first = ranges[0].first_byte_position();
+    last = ranges[0].last_byte_position();
+  }
+  ++*responses;
+  bool stall = config.stall_every > 0 && !(*responses % config.stall_every);
+  return base::MakeUnique<ThrottledResponse>(first, last, stall, config);
+}
+
+void OnInitialized(const scoped_refptr<base::SingleThreadTaskRunner>& loop,
+                   const base::Closure& quit,
+                   bool* success_out,
+                   bool success) {
+  *success_out = success;
+  loop->PostTask(FROM_HERE, quit);
+}
+
+void OnRead(const scoped_refptr<base::SingleThreadTaskRunner>& loop,
+            const base::Closure& quit,
+            int* result_out,
+            int result) {
+  *result_out = result;
+  loop->PostTask(FROM_HERE, quit);
+}
+
+int ReadAt(media::DataSource* source, int64_t position, int size,
+           uint8_t* data) {
+  base::RunLoop run_loop;
+  int result = media::DataSource::kReadError;
+  source->Read(position, size, data,
+               base::Bind(&OnRead, base::ThreadTaskRunnerHandle::Get(),
+                          run_loop.QuitClosure(), &result));
+  run_loop.Run();
+  return result;
+}
+
+// Reads may return less than asked for, e.g. up to the end of a block.
+bool ReadFully(media::DataSource* source, int64_t position, int size,
+               uint8_t* data) {
+  for (int done = 0; done < size;) {
+    int result = ReadAt(source, position + done, size - done, data + done);
+    if (result <= 0)
+      return false;
+    done += result;
+  }
+  return true;
+}
+
+void SleepUntil(base::TimeTicks time) {
+  base::TimeDelta delay = time - base::TimeTicks::Now();
+  if (delay <= base::TimeDelta())
+    return;
+  base::RunLoop run_loop;
+  base::ThreadTaskRunnerHandle::Get()->PostDelayedTask(
+      FROM_HERE, run_loop.QuitClosure(), delay);
+  run_loop.Run();
+}
+
+struct Result {
+  bool ok;
+  base::TimeDelta startup;
+  base::TimeDelta stalled;
+  int stalls;
+};
+
+// Plays |url| at |bitrate| bits per second. Playback starts once the first
+// read completed and stalls whenever a read completes after its data was
+// due, reads run at most |buffer| ahead of playback.
+Result Play(const GURL& url,
+            int parallel_fetchers,
+            int64_t total_bytes,
+            int64_t bitrate,
+            base::TimeDelta buffer,
+            const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner) {
+  Result result = {false, base::TimeDelta(), base::TimeDelta(), 0};
+  media::ResourceMultiBuffer::Options options;
+  options.parallel_fetchers = parallel_fetchers;
+  media::ResourceDataSource source(url, base::ThreadTaskRunnerHandle::Get(),
+                                   io_task_runner, options);
+  source.SetBitrate(static_cast<int>(bitrate));
+  std::vector<uint8_t> data(kReadBytes);
+  const base::TimeTicks start = base::TimeTicks::Now();
+  {
+    base::RunLoop run_loop;
+    bool success = false;
+    source.Initialize(base::Bind(&OnInitialized,
+                                 base::ThreadTaskRunnerHandle::Get(),
+                                 run_loop.QuitClosure(), &success));
+    run_loop.Run();
+    if (!success)
+      return result;
+  }
+  // Wall time at which playback reaches byte 0, moved by every stall.
+  base::TimeTicks play_origin;
+  for (int64_t position = 0; position < total_bytes;
+       position += kReadBytes) {
+    const base::TimeDelta media_time = base::TimeDelta::FromMicroseconds(
+        position * 8 * base::Time::kMicrosecondsPerSecond / bitrate);
+    if (position)
+      SleepUntil(play_origin + media_time - buffer);
+    int size = static_cast<int>(
+        std::min<int64_t>(kReadBytes, total_bytes - position));
+    if (!ReadFully(&source, position, size, data.data())) {
+      source.Stop();
+      return result;
+    }
+    base::TimeTicks now = base::TimeTicks::Now();
+    if (!position) {
+      result.startup = now - start;
+      play_origin = now;
+      continue;
+    }
+    base::TimeTicks due = play_origin + media_time;
+    if (now > due) {
+      result.stalled += now - due;
+      ++result.stalls;
+      play_origin += now - due;
+    }
+  }
+  source.Stop();
+  result.ok = true;
+  return result;
+}
+
+void Print(const char* name, const Result& result) {
+  if (!result.ok) {
+    printf("%-12s failed\n", name);
+    return;
+  }
+  printf("%-12s startup %8.0f ms   stalled %8.0f ms in %d stalls\n", name,
+         result.startup.InMillisecondsF(), result.stalled.InMillisecondsF(),
+         result.stalls);
+}
+
+int64_t GetSwitch(const base::CommandLine* command_line,
+                  const char* name,
+                  int64_t default_value) {
+  int64_t value;
+  if (!command_line->HasSwitch(name) ||
+      !base::StringToInt64(command_line->GetSwitchValueASCII(name), &value)) {
+    return default_value;
+  }
+  return value;
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+  base::AtExitManager at_exit;
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* command_line = base::CommandLine::ForCurrentProcess();
+
+  const int fetchers = static_cast<int>(GetSwitch(command_line, "fetchers", 4));
+  const int64_t bitrate = GetSwitch(command_line, "bitrate", 4000000);
+  const int64_t seconds = GetSwitch(command_line, "seconds", 30);
+  const base::TimeDelta buffer = base::TimeDelta::FromSeconds(
+      GetSwitch(command_line, "buffer-seconds", 5));
+  ServerConfig config;
+  config.connection_bits_per_second =
+      GetSwitch(command_line, "connection-kbps", 3000) * 1000;
+  config.total_bytes = bitrate / 8 * seconds;
+  config.stall_every =
+      static_cast<int>(GetSwitch(command_line, "stall-every", 8));
+  config.stall = base::TimeDelta::FromMilliseconds(
+      GetSwitch(command_line, "stall-ms", 2000));
+  if (fetchers <= 0 || bitrate <= 0 || config.total_bytes <= 0 ||
+      config.connection_bits_per_second <= 0) {
+    LOG(ERROR) << "Usage:\n ./range_fetch_benchmark [--fetchers=N] "
+                  "[--connection-kbps=N] [--bitrate=N] [--seconds=N] "
+                  "[--buffer-seconds=N] [--stall-every=N] [--stall-ms=N]";
+    return 1;
+  }
+
+  base::MessageLoopForIO message_loop;
+  base::TaskScheduler::Create("range_fetch_benchmark");
+  base::TaskScheduler::GetInstance()->Start(
+      *media::MediaContext::Get()->GetDefaultTaskSchedulerInitParams());
+  base::Thread io_thread("IO");
+  io_thread.StartWithOptions(
+      base::Thread::Options(base::MessageLoop::TYPE_IO, 0));
+
+  // Only used on the server thread.
+  int responses = 0;
+  net::EmbeddedTestServer test_server;
+  test_server.RegisterRequestHandler(
+      base::Bind(&HandleRequest, config, base::Unretained(&responses)));
+  if (!test_server.Start()) {
+    LOG(ERROR) << "Can't start the test server";
+    return 1;
+  }
+
+  printf("%" PRId64 " bytes at %" PRId64 " bit/s, %" PRId64
+         " kbit/s per connection\n",
+         config.total_bytes, bitrate, config.connection_bits_per_second / 1000);
+  // Other URLs, so that the runs don't share cached blocks.
+  Print("single", Play(test_server.GetURL("/media?single"), 0,
+                       config.total_bytes, bitrate, buffer,
+                       io_thread.task_runner()));
+  std::string name = base::StringPrintf("parallel %d", fetchers);
+  Print(name.c_str(), Play(test_server.GetURL("/media?parallel"), fetchers,
+                           config.total_bytes, bitrate, buffer,
+                           io_thread.task_runner()));
+
+  io_thread.Stop();
+  base::TaskScheduler::GetInstance()->Shutdown();
+  return 0;
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#include "chromium_media_lib/buffer_data_source.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/callback_helpers.h"
+
+namespace media {
+
+BufferDataSource::BufferDataSource(scoped_refptr<base::RefCountedMemory> buffer)
+    : buffer_(buffer),
+      data_(buffer->front()),
+      size_(static_cast<int64_t>(buffer->size())),
+      stop_signal_received_(false) {}
+
+BufferDataSource::BufferDataSource(const uint8_t* data,
+                                   size_t size,
+                                   const base::Closure& release_cb)
+    : data_(data),
+      size_(static_cast<int64_t>(size)),
+      release_cb_(release_cb),
+      stop_signal_received_(false) {}
+
+BufferDataSource::~BufferDataSource() {
+  if (!release_cb_.is_null())
+    base::ResetAndReturn(&release_cb_).Run();
+}
+
+void BufferDataSource::Stop() {
+  base::AutoLock auto_lock(lock_);
+  stop_signal_received_ = true;
+}
+
+void BufferDataSource::Abort() {
+  // Reads complete synchronously, there is never one to abort.
+}
+
+void BufferDataSource::Read(int64_t position,
+                            int size,
+                            uint8_t* data,
+                            const DataSource::ReadCB& read_cb) {
+  DCHECK(!read_cb.is_null());
+  int result = kReadError;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (!stop_signal_received_ && position >= 0 && position < size_) {
+      result = static_cast<int>(
+          std::min<int64_t>(size_ - position, static_cast<int64_t>(size)));
+      memcpy(data, data_ + position, result);
+    }
+  }
+  read_cb.Run(result);
+}
+
+bool BufferDataSource::GetSize(int64_t* size_out) {
+  *size_out = size_;
+  return true;
+}
+
+bool BufferDataSource::IsStreaming() {
+  return false;
+}
+
+void BufferDataSource::SetBitrate(int bitrate) {
+  // Do nothing
+}
+
+}  // namespace media
@@ -0,0 +1,56 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_BUFFER_DATA_SOURCE_H_
+#define CHROMIUM_MEDIA_LIB_BUFFER_DATA_SOURCE_H_
+
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/synchronization/lock.h"
+#include "media/base/data_source.h"
+
+namespace media {
+
+// Serves media the application already holds in memory. Reads are copied
+// straight out of the caller-supplied buffer and run their ReadCB
+// synchronously on the calling (demuxer) thread, no task is posted.
+class BufferDataSource : public DataSource {
+ public:
+  // Keeps a reference to |buffer| for the lifetime of the source.
+  explicit BufferDataSource(scoped_refptr<base::RefCountedMemory> buffer);
+  // |data| must stay valid until |release_cb| is run, which happens when the
+  // source is destroyed.
+  BufferDataSource(const uint8_t* data,
+                   size_t size,
+                   const base::Closure& release_cb);
+  ~BufferDataSource() override;
+
+  // DataSource implementation.
+  // Called from demuxer thread.
+  void Stop() override;
+  void Abort() override;
+
+  void Read(int64_t position,
+            int size,
+            uint8_t* data,
+            const DataSource::ReadCB& read_cb) override;
+  bool GetSize(int64_t* size_out) override;
+  bool IsStreaming() override;
+  void SetBitrate(int bitrate) override;
+
+ private:
+  scoped_refptr<base::RefCountedMemory> buffer_;
+  const uint8_t* const data_;
+  const int64_t size_;
+  base::Closure release_cb_;
+
+  base::Lock lock_;
+  bool stop_signal_received_;
+
+  DISALLOW_COPY_AND_ASSIGN(BufferDataSource);
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_BUFFER_DATA_SOURCE_H_
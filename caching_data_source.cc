@@ -0,0 +1,197 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#include "chromium_media_lib/caching_data_source.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/memory/ptr_util.h"
+
+namespace media {
+
+CachingDataSource::Options::Options() : block_size(0), max_blocks(8) {}
+
+CachingDataSource::Block::Block(int64_t start, int size)
+    : start(start), length(0), data(new uint8_t[size]) {}
+
+CachingDataSource::Block::~Block() {}
+
+CachingDataSource::CachingDataSource(std::unique_ptr<DataSource> source,
+                                     const Options& options)
+    : source_(std::move(source)),
+      block_size_(options.block_size),
+      max_blocks_(options.max_blocks),
+      stop_signal_received_(false),
+      hits_(0),
+      misses_(0),
+      coalesced_(0),
+      bypassed_(0) {
+  DCHECK_GT(block_size_, 0);
+}
+
+CachingDataSource::~CachingDataSource() {
+  LOG(INFO) << "CachingDataSource hits=" << hits_ << " misses=" << misses_
+            << " coalesced=" << coalesced_ << " bypassed=" << bypassed_
+            << " hit_ratio=" << GetHitRatio();
+}
+
+void CachingDataSource::Stop() {
+  {
+    base::AutoLock auto_lock(lock_);
+    stop_signal_received_ = true;
+  }
+  // Fails the fetches in flight, which fails their waiters.
+  source_->Stop();
+}
+
+void CachingDataSource::Abort() {
+  source_->Abort();
+}
+
+void CachingDataSource::Read(int64_t position,
+                             int size,
+                             uint8_t* data,
+                             const DataSource::ReadCB& read_cb) {
+  DCHECK(!read_cb.is_null());
+  Block* fetch = nullptr;
+  int result = kReadError;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (stop_signal_received_) {
+      read_cb.Run(kReadError);
+      return;
+    }
+    if (size >= block_size_) {
+      ++bypassed_;
+    } else {
+      result = CopyFromCache(position, size, data);
+      if (result > 0) {
+        ++hits_;
+      } else {
+        int64_t start = position - position % block_size_;
+        for (const auto& block : fetches_) {
+          if (block->start == start) {
+            // Coalesced into a fetch in flight, no round trip of its own
+            // but it waits for one.
+            ++coalesced_;
+            block->waiters.push_back(base::MakeUnique<ReadOperation>(
+                position, size, data, read_cb));
+            return;
+          }
+        }
+        ++misses_;
+        fetches_.push_back(base::MakeUnique<Block>(start, block_size_));
+        fetch = fetches_.back().get();
+        fetch->waiters.push_back(
+            base::MakeUnique<ReadOperation>(position, size, data, read_cb));
+      }
+    }
+  }
+
+  // The wrapped source may complete synchronously, so it is never called
+  // with |lock_| held.
+  if (fetch) {
+    // |source_| is owned and completes or drops its reads before it is
+    // destroyed.
+    source_->Read(fetch->start, block_size_, fetch->data.get(),
+                  base::Bind(&CachingDataSource::OnFetchDone,
+                             base::Unretained(this), fetch));
+  } else if (result > 0) {
+    read_cb.Run(result);
+  } else {
+    source_->Read(position, size, data, read_cb);
+  }
+}
+
+bool CachingDataSource::GetSize(int64_t* size_out) {
+  return source_->GetSize(size_out);
+}
+
+bool CachingDataSource::IsStreaming() {
+  return source_->IsStreaming();
+}
+
+void CachingDataSource::SetBitrate(int bitrate) {
+  source_->SetBitrate(bitrate);
+}
+
+double CachingDataSource::GetHitRatio() {
+  base::AutoLock auto_lock(lock_);
+  int64_t total = hits_ + misses_ + coalesced_;
+  return total ? static_cast<double>(hits_) / total : 0.0;
+}
+
+void CachingDataSource::OnFetchDone(Block* block, int result) {
+  std::vector<std::unique_ptr<ReadOperation>> waiters;
+  std::vector<int> results;
+  {
+    base::AutoLock auto_lock(lock_);
+    auto it = std::find_if(
+        fetches_.begin(), fetches_.end(),
+        [block](const std::unique_ptr<Block>& b) { return b.get() == block; });
+    DCHECK(it != fetches_.end());
+    std::unique_ptr<Block> fetched = std::move(*it);
+    fetches_.erase(it);
+    waiters.swap(fetched->waiters);
+
+    for (const auto& read_op : waiters) {
+      int64_t offset = read_op->position() - block->start;
+      if (result <= 0) {
+        results.push_back(result);
+      } else if (offset < result) {
+        int length = std::min(result - static_cast<int>(offset),
+                              read_op->size());
+        memcpy(read_op->data(), block->data.get() + offset, length);
+        results.push_back(length);
+      } else {
+        // The wrapped source returned a short read not reaching this one,
+        // it is sent on as is below.
+        results.push_back(0);
+      }
+    }
+
+    if (result > 0 && !stop_signal_received_) {
+      // Replaces what an earlier short fetch left of the same block.
+      blocks_.remove_if([block](const std::unique_ptr<Block>& b) {
+        return b->start == block->start;
+      });
+      fetched->length = result;
+      blocks_.push_front(std::move(fetched));
+      if (blocks_.size() > max_blocks_)
+        blocks_.pop_back();
+    }
+  }
+
+  for (size_t i = 0; i < waiters.size(); ++i) {
+    if (result > 0 && !results[i]) {
+      ReadOperation* read_op = waiters[i].get();
+      source_->Read(read_op->position(), read_op->size(), read_op->data(),
+                    base::Bind(&ReadOperation::Run,
+                               base::Passed(&waiters[i])));
+      continue;
+    }
+    ReadOperation::Run(std::move(waiters[i]), results[i]);
+  }
+}
+
+int CachingDataSource::CopyFromCache(int64_t position,
+                                     int size,
+                                     uint8_t* data) {
+  lock_.AssertAcquired();
+  for (auto it = blocks_.begin(); it != blocks_.end(); ++it) {
+    Block* block = it->get();
+    if (position < block->start || position >= block->start + block->length)
+      continue;
+    int64_t offset = position - block->start;
+    int length = static_cast<int>(
+        std::min<int64_t>(block->length - offset, static_cast<int64_t>(size)));
+    memcpy(data, block->data.get() + offset, length);
+    blocks_.splice(blocks_.begin(), blocks_, it);
+    return length;
+  }
+  return 0;
+}
+
+}  // namespace media
@@ -0,0 +1,93 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_CACHING_DATA_SOURCE_H_
+#define CHROMIUM_MEDIA_LIB_CACHING_DATA_SOURCE_H_
+
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/synchronization/lock.h"
+#include "chromium_media_lib/read_operation.h"
+#include "media/base/data_source.h"
+
+namespace media {
+
+// Decorates another DataSource for FFmpeg's access pattern of many small
+// reads. A small read which misses is widened into an aligned fetch of
+// |block_size| bytes, and the most recently fetched blocks are kept so that
+// adjacent and repeated reads are served from memory without a round trip
+// through the wrapped source. Reads of at least |block_size| bypass the
+// cache.
+class CachingDataSource : public DataSource {
+ public:
+  struct Options {
+    Options();
+
+    // Zero disables the cache.
+    int block_size;
+    int max_blocks;
+  };
+
+  CachingDataSource(std::unique_ptr<DataSource> source, const Options& options);
+  ~CachingDataSource() override;
+
+  // DataSource implementation.
+  // Called from demuxer thread.
+  void Stop() override;
+  void Abort() override;
+
+  void Read(int64_t position,
+            int size,
+            uint8_t* data,
+            const DataSource::ReadCB& read_cb) override;
+  bool GetSize(int64_t* size_out) override;
+  bool IsStreaming() override;
+  void SetBitrate(int bitrate) override;
+
+  // Fraction of the reads below |block_size| served from memory. Reads
+  // coalesced into a fetch already in flight still wait for the wrapped
+  // source and don't count as hits.
+  double GetHitRatio();
+
+ private:
+  struct Block {
+    Block(int64_t start, int size);
+    ~Block();
+
+    const int64_t start;
+    // Bytes actually fetched, may be less than |block_size| near the end or
+    // when the wrapped source returned a short read.
+    int length;
+    std::unique_ptr<uint8_t[]> data;
+    // Reads waiting for the block while it is being fetched.
+    std::vector<std::unique_ptr<ReadOperation>> waiters;
+  };
+
+  void OnFetchDone(Block* block, int result);
+  // Copies from a cached block covering |position| and returns the bytes
+  // copied, or 0 if there is none. |lock_| must be held.
+  int CopyFromCache(int64_t position, int size, uint8_t* data);
+
+  std::unique_ptr<DataSource> source_;
+  const int block_size_;
+  const size_t max_blocks_;
+
+  base::Lock lock_;
+  bool stop_signal_received_;
+  // Most recently used first.
+  std::list<std::unique_ptr<Block>> blocks_;
+  std::list<std::unique_ptr<Block>> fetches_;
+
+  int64_t hits_;
+  int64_t misses_;
+  int64_t coalesced_;
+  int64_t bypassed_;
+
+  DISALLOW_COPY_AND_ASSIGN(CachingDataSource);
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_CACHING_DATA_SOURCE_H_
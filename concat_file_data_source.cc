@@ -0,0 +1,175 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#include "chromium_media_lib/concat_file_data_source.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/callback_helpers.h"
+#include "base/location.h"
+#include "base/memory/ptr_util.h"
+
+namespace media {
+
+ConcatFileDataSource::Segment::Segment() {}
+
+ConcatFileDataSource::Segment::~Segment() {}
+
+ConcatFileDataSource::ConcatFileDataSource(
+    const std::vector<base::FilePath>& paths,
+    const scoped_refptr<base::SingleThreadTaskRunner>& task_runner,
+    const FileDataSource::Options& options)
+    : render_task_runner_(task_runner),
+      options_(options),
+      paths_(paths),
+      total_bytes_(-1),
+      stop_signal_received_(false),
+      weak_factory_(this) {}
+
+ConcatFileDataSource::~ConcatFileDataSource() {}
+
+void ConcatFileDataSource::Initialize(const InitializeCB& init_cb) {
+  DCHECK(render_task_runner_->BelongsToCurrentThread());
+  DCHECK(!init_cb.is_null());
+  bool success = !paths_.empty();
+  std::vector<std::unique_ptr<Segment>> segments;
+  std::vector<int64_t> segment_offsets;
+  int64_t total_bytes = 0;
+  for (const base::FilePath& path : paths_) {
+    base::File file(path, base::File::FLAG_OPEN | base::File::FLAG_READ);
+    if (!file.IsValid()) {
+      LOG(ERROR) << "Can't open segment " << path.value();
+      success = false;
+      break;
+    }
+    // Empty segments hold no data and would break the binary search.
+    // base::MemoryMappedFile can't map them either.
+    if (!file.GetLength())
+      continue;
+    std::unique_ptr<Segment> segment = base::MakeUnique<Segment>();
+    if (!segment->file.Initialize(std::move(file))) {
+      LOG(ERROR) << "Can't map segment " << path.value();
+      success = false;
+      break;
+    }
+    segment->advisor.reset(new MappedFileAdvisor(
+        segment->file.data(), segment->file.length(), options_.prefetch_window,
+        options_.release_window));
+    segment_offsets.push_back(total_bytes);
+    total_bytes += segment->file.length();
+    segments.push_back(std::move(segment));
+  }
+  {
+    base::AutoLock auto_lock(lock_);
+    if (success) {
+      segments_.swap(segments);
+      segment_offsets_.swap(segment_offsets);
+      total_bytes_ = total_bytes;
+    }
+  }
+  init_cb_ = init_cb;
+  render_task_runner_->PostTask(
+      FROM_HERE, base::Bind(base::ResetAndReturn(&init_cb_), success));
+}
+
+void ConcatFileDataSource::Stop() {
+  base::AutoLock auto_lock(lock_);
+  stop_signal_received_ = true;
+  read_ops_.RunAll(kReadError);
+}
+
+void ConcatFileDataSource::Abort() {
+  // Only the pending reads are aborted, future reads are still served.
+  base::AutoLock auto_lock(lock_);
+  read_ops_.RunAll(kAborted);
+}
+
+void ConcatFileDataSource::Read(int64_t position,
+                                int size,
+                                uint8_t* data,
+                                const DataSource::ReadCB& read_cb) {
+  DCHECK(!read_cb.is_null());
+  if (options_.inline_reads) {
+    int result = kReadError;
+    {
+      base::AutoLock auto_lock(lock_);
+      if (!stop_signal_received_)
+        result = CopyFromSegments(position, size, data);
+    }
+    read_cb.Run(result);
+    return;
+  }
+  int read_id;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (stop_signal_received_) {
+      read_cb.Run(kReadError);
+      return;
+    }
+    read_id = read_ops_.Add(
+        base::MakeUnique<ReadOperation>(position, size, data, read_cb));
+  }
+  render_task_runner_->PostTask(
+      FROM_HERE, base::Bind(&ConcatFileDataSource::ReadTask,
+                            weak_factory_.GetWeakPtr(), read_id));
+}
+
+bool ConcatFileDataSource::GetSize(int64_t* size_out) {
+  base::AutoLock auto_lock(lock_);
+  if (total_bytes_ != -1) {
+    *size_out = total_bytes_;
+    return true;
+  }
+  *size_out = 0;
+  return false;
+}
+
+bool ConcatFileDataSource::IsStreaming() {
+  return false;
+}
+
+void ConcatFileDataSource::SetBitrate(int bitrate) {
+  // Do nothing
+}
+
+void ConcatFileDataSource::ReadTask(int read_id) {
+  DCHECK(render_task_runner_->BelongsToCurrentThread());
+  base::AutoLock auto_lock(lock_);
+  std::unique_ptr<ReadOperation> read_op = read_ops_.Take(read_id);
+  if (stop_signal_received_ || !read_op)
+    return;
+
+  DCHECK(read_op->size());
+  int result = CopyFromSegments(read_op->position(), read_op->size(),
+                                read_op->data());
+  ReadOperation::Run(std::move(read_op), result);
+}
+
+int ConcatFileDataSource::CopyFromSegments(int64_t position,
+                                           int size,
+                                           uint8_t* data) {
+  lock_.AssertAcquired();
+  if (position < 0 || position >= total_bytes_)
+    return kReadError;
+  // Last segment starting at or before |position|.
+  size_t index = std::upper_bound(segment_offsets_.begin(),
+                                  segment_offsets_.end(), position) -
+                 segment_offsets_.begin() - 1;
+  int bytes_read = 0;
+  while (size > 0 && index < segments_.size()) {
+    Segment* segment = segments_[index].get();
+    int64_t offset = position - segment_offsets_[index];
+    int length = static_cast<int>(std::min<int64_t>(
+        segment->file.length() - offset, static_cast<int64_t>(size)));
+    segment->advisor->OnRead(offset, length);
+    memcpy(data + bytes_read, segment->file.data() + offset, length);
+    bytes_read += length;
+    position += length;
+    size -= length;
+    ++index;
+  }
+  return bytes_read;
+}
+
+}  // namespace media
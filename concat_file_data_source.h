@@ -0,0 +1,88 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_CONCAT_FILE_DATA_SOURCE_H_
+#define CHROMIUM_MEDIA_LIB_CONCAT_FILE_DATA_SOURCE_H_
+
+#include <memory>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/files/file_path.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/macros.h"
+#include "base/memory/weak_ptr.h"
+#include "base/single_thread_task_runner.h"
+#include "base/synchronization/lock.h"
+#include "chromium_media_lib/file_data_source.h"
+#include "chromium_media_lib/mapped_file_advisor.h"
+#include "chromium_media_lib/read_operation.h"
+#include "media/base/data_source.h"
+
+namespace media {
+
+// Presents an ordered list of files, e.g. a recording split into chunks, as
+// one contiguous byte stream. Every segment is memory-mapped on its own and
+// reads crossing a segment boundary are copied piecewise straight into the
+// caller's buffer. Honors the inline_reads and paging hint options of
+// FileDataSource::Options, the backend is always kMemoryMapped.
+class ConcatFileDataSource : public DataSource {
+ public:
+  ConcatFileDataSource(
+      const std::vector<base::FilePath>& paths,
+      const scoped_refptr<base::SingleThreadTaskRunner>& task_runner,
+      const FileDataSource::Options& options);
+  ~ConcatFileDataSource() override;
+
+  typedef base::Callback<void(bool)> InitializeCB;
+  void Initialize(const InitializeCB& init_cb);
+
+  // DataSource implementation.
+  // Called from demuxer thread.
+  void Stop() override;
+  void Abort() override;
+
+  void Read(int64_t position,
+            int size,
+            uint8_t* data,
+            const DataSource::ReadCB& read_cb) override;
+  bool GetSize(int64_t* size_out) override;
+  bool IsStreaming() override;
+  void SetBitrate(int bitrate) override;
+
+ private:
+  struct Segment {
+    Segment();
+    ~Segment();
+
+    base::MemoryMappedFile file;
+    std::unique_ptr<MappedFileAdvisor> advisor;
+  };
+
+  void ReadTask(int read_id);
+  // Copies from the segments into |data| and returns the bytes copied or
+  // kReadError. |lock_| must be held.
+  int CopyFromSegments(int64_t position, int size, uint8_t* data);
+
+ private:
+  const scoped_refptr<base::SingleThreadTaskRunner> render_task_runner_;
+  const FileDataSource::Options options_;
+  std::vector<base::FilePath> paths_;
+  std::vector<std::unique_ptr<Segment>> segments_;
+  // |segment_offsets_[i]| is the stream position of the first byte of
+  // |segments_[i]|, binary searched on every read.
+  std::vector<int64_t> segment_offsets_;
+  int64_t total_bytes_;
+  base::Lock lock_;
+  bool stop_signal_received_;
+  InitializeCB init_cb_;
+
+  ReadOperationQueue read_ops_;
+
+  base::WeakPtrFactory<ConcatFileDataSource> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConcatFileDataSource);
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_CONCAT_FILE_DATA_SOURCE_H_
@@ -0,0 +1,46 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_CUSTOM_DATA_PROVIDER_H_
+#define CHROMIUM_MEDIA_LIB_CUSTOM_DATA_PROVIDER_H_
+
+#include <stdint.h>
+
+#include "base/callback.h"
+#include "media/base/media_export.h"
+
+namespace media {
+
+// Implemented by applications which supply the media bytes themselves, e.g.
+// from an object store with its own asynchronous I/O and caching. Pass it to
+// MediaPlayerImpl::Load().
+class MEDIA_EXPORT CustomDataProvider {
+ public:
+  // Runs with the number of bytes read, 0 at the end of the stream or
+  // DataSource::kReadError.
+  typedef base::Callback<void(int result)> ReadCompletionCB;
+
+  virtual ~CustomDataProvider() {}
+
+  // Returns false if the size isn't known (yet).
+  virtual bool GetSize(int64_t* size_out) = 0;
+  // Whether the stream is live and can't be seeked.
+  virtual bool IsStreaming() = 0;
+
+  // Reads up to |size| bytes at |position| directly into |data|. |done| may
+  // be run on any thread, synchronously from within Read() as well. Several
+  // reads may be outstanding at the same time.
+  virtual void Read(int64_t position,
+                    int size,
+                    uint8_t* data,
+                    const ReadCompletionCB& done) = 0;
+
+  // The outstanding reads are abandoned, the player completes them itself.
+  // Their |data| must not be written once these return. After Stop() no more
+  // reads are issued.
+  virtual void Abort() = 0;
+  virtual void Stop() = 0;
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_CUSTOM_DATA_PROVIDER_H_
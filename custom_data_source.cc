@@ -0,0 +1,105 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#include "chromium_media_lib/custom_data_source.h"
+
+#include "base/bind.h"
+#include "base/memory/ptr_util.h"
+
+namespace media {
+
+CustomDataSource::PendingReads::PendingReads()
+    : dispatch_done_(&lock_), stop_signal_received_(false), dispatching_(0) {}
+
+CustomDataSource::PendingReads::~PendingReads() {}
+
+int CustomDataSource::PendingReads::Add(
+    std::unique_ptr<ReadOperation> read_op) {
+  base::AutoLock auto_lock(lock_);
+  if (stop_signal_received_) {
+    ReadOperation::Run(std::move(read_op), kReadError);
+    return 0;
+  }
+  ++dispatching_;
+  return read_ops_.Add(std::move(read_op));
+}
+
+void CustomDataSource::PendingReads::DispatchDone() {
+  base::AutoLock auto_lock(lock_);
+  DCHECK_GT(dispatching_, 0);
+  if (!--dispatching_)
+    dispatch_done_.Broadcast();
+}
+
+void CustomDataSource::PendingReads::OnReadDone(int read_id, int result) {
+  base::AutoLock auto_lock(lock_);
+  // Already completed by Abort() or Stop().
+  std::unique_ptr<ReadOperation> read_op = read_ops_.Take(read_id);
+  if (read_op)
+    ReadOperation::Run(std::move(read_op), result);
+}
+
+void CustomDataSource::PendingReads::StopDispatch() {
+  base::AutoLock auto_lock(lock_);
+  stop_signal_received_ = true;
+  // The lock is released while waiting, a read the provider completes
+  // synchronously still gets through OnReadDone().
+  while (dispatching_)
+    dispatch_done_.Wait();
+}
+
+void CustomDataSource::PendingReads::RunAll(int result, bool stop) {
+  base::AutoLock auto_lock(lock_);
+  stop_signal_received_ |= stop;
+  read_ops_.RunAll(result);
+}
+
+CustomDataSource::CustomDataSource(
+    std::unique_ptr<CustomDataProvider> provider)
+    : provider_(std::move(provider)), pending_reads_(new PendingReads()) {}
+
+CustomDataSource::~CustomDataSource() {}
+
+void CustomDataSource::Stop() {
+  pending_reads_->StopDispatch();
+  // The provider lets go of the outstanding buffers before they are handed
+  // back to the demuxer.
+  provider_->Stop();
+  pending_reads_->RunAll(kReadError, true);
+}
+
+void CustomDataSource::Abort() {
+  provider_->Abort();
+  pending_reads_->RunAll(kAborted, false);
+}
+
+void CustomDataSource::Read(int64_t position,
+                            int size,
+                            uint8_t* data,
+                            const DataSource::ReadCB& read_cb) {
+  DCHECK(!read_cb.is_null());
+  int read_id = pending_reads_->Add(
+      base::MakeUnique<ReadOperation>(position, size, data, read_cb));
+  if (!read_id)
+    return;
+  provider_->Read(
+      position, size, data,
+      base::Bind(&PendingReads::OnReadDone, pending_reads_, read_id));
+  pending_reads_->DispatchDone();
+}
+
+bool CustomDataSource::GetSize(int64_t* size_out) {
+  if (provider_->GetSize(size_out))
+    return true;
+  *size_out = 0;
+  return false;
+}
+
+bool CustomDataSource::IsStreaming() {
+  return provider_->IsStreaming();
+}
+
+void CustomDataSource::SetBitrate(int bitrate) {
+  // Do nothing
+}
+
+}  // namespace media
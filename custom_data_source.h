@@ -0,0 +1,80 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_CUSTOM_DATA_SOURCE_H_
+#define CHROMIUM_MEDIA_LIB_CUSTOM_DATA_SOURCE_H_
+
+#include <memory>
+
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "chromium_media_lib/custom_data_provider.h"
+#include "chromium_media_lib/read_operation.h"
+#include "media/base/data_source.h"
+
+namespace media {
+
+// Adapts a CustomDataProvider to the DataSource interface. The demuxer's
+// buffer is handed to the provider as is and its completion is forwarded on
+// whichever thread it arrives, so there is no extra copy and no extra hop.
+class CustomDataSource : public DataSource {
+ public:
+  explicit CustomDataSource(std::unique_ptr<CustomDataProvider> provider);
+  ~CustomDataSource() override;
+
+  // DataSource implementation.
+  // Called from demuxer thread.
+  void Stop() override;
+  void Abort() override;
+
+  void Read(int64_t position,
+            int size,
+            uint8_t* data,
+            const DataSource::ReadCB& read_cb) override;
+  bool GetSize(int64_t* size_out) override;
+  bool IsStreaming() override;
+  void SetBitrate(int bitrate) override;
+
+ private:
+  // Outstanding reads. Reference counted since the provider may complete a
+  // read after the source went away.
+  class PendingReads : public base::RefCountedThreadSafe<PendingReads> {
+   public:
+    PendingReads();
+
+    // Returns the read id, or 0 after failing |read_op| once stopped. A
+    // non-zero id must be followed by DispatchDone() once the read was
+    // handed to the provider.
+    int Add(std::unique_ptr<ReadOperation> read_op);
+    void DispatchDone();
+    void OnReadDone(int read_id, int result);
+    // Fails reads added from now on and waits until the provider got the
+    // ones being dispatched, so that none reaches it after its Stop().
+    void StopDispatch();
+    void RunAll(int result, bool stop);
+
+   private:
+    friend class base::RefCountedThreadSafe<PendingReads>;
+    ~PendingReads();
+
+    base::Lock lock_;
+    // Signaled when |dispatching_| drops to 0.
+    base::ConditionVariable dispatch_done_;
+    bool stop_signal_received_;
+    // Reads added but not yet handed to the provider.
+    int dispatching_;
+    ReadOperationQueue read_ops_;
+
+    DISALLOW_COPY_AND_ASSIGN(PendingReads);
+  };
+
+  std::unique_ptr<CustomDataProvider> provider_;
+  scoped_refptr<PendingReads> pending_reads_;
+
+  DISALLOW_COPY_AND_ASSIGN(CustomDataSource);
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_CUSTOM_DATA_SOURCE_H_
@@ -0,0 +1,154 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#include "chromium_media_lib/direct_file_reader.h"
+
+#include <fcntl.h>
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/memory/ptr_util.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/task_scheduler/post_task.h"
+#include "build/build_config.h"
+#include "media/base/data_source.h"
+
+namespace media {
+
+namespace {
+
+// O_DIRECT needs buffers, offsets and sizes aligned to the logical block
+// size of the device, 4k covers all of them.
+const int kAlignment = 4096;
+const int kChunkSize = 1024 * 1024;
+// The chunk being read from plus the ones read ahead of it.
+const int kRingSize = 4;
+
+}  // namespace
+
+DirectFileReader::Chunk::Chunk() : offset(-1), length(0), last_use(0) {}
+
+DirectFileReader::Chunk::~Chunk() {}
+
+// static
+base::File DirectFileReader::OpenFile(const base::FilePath& path) {
+#if defined(OS_LINUX)
+  int fd = HANDLE_EINTR(
+      open(path.value().c_str(), O_RDONLY | O_DIRECT | O_CLOEXEC));
+  if (fd >= 0)
+    return base::File(fd);
+  PLOG(WARNING) << "O_DIRECT open failed, using buffered I/O for "
+                << path.value();
+#endif
+  return base::File(path, base::File::FLAG_OPEN | base::File::FLAG_READ);
+}
+
+DirectFileReader::DirectFileReader(base::File file, Client* client)
+    : PositionedFileReader(std::move(file), client),
+      task_runner_(base::CreateSequencedTaskRunnerWithTraits(
+          {base::MayBlock(), base::TaskPriority::USER_BLOCKING})),
+      use_counter_(0),
+      next_position_(0),
+      read_ahead_until_(0) {
+  for (int i = 0; i < kRingSize; ++i) {
+    ring_.push_back(base::MakeUnique<Chunk>());
+    ring_.back()->data.reset(
+        static_cast<uint8_t*>(base::AlignedAlloc(kChunkSize, kAlignment)));
+  }
+}
+
+DirectFileReader::~DirectFileReader() {}
+
+void DirectFileReader::Read(int read_id, int64_t position, int size) {
+  task_runner_->PostTask(FROM_HERE,
+                         base::Bind(&DirectFileReader::ReadOnSequence, this,
+                                    read_id, position, size));
+}
+
+void DirectFileReader::ReadOnSequence(int read_id,
+                                      int64_t position,
+                                      int size) {
+  DCHECK(task_runner_->RunsTasksInCurrentSequence());
+  bool sequential = position == next_position_;
+  Chunk* chunk = GetChunk(position);
+  if (!chunk) {
+    NotifyClient(read_id, DataSource::kReadError, nullptr);
+    return;
+  }
+  // Short reads are fine, a read crossing the end of the chunk gets the
+  // rest with its next call.
+  int64_t offset_in_chunk = position - chunk->offset;
+  int result = static_cast<int>(std::max<int64_t>(
+      0, std::min<int64_t>(chunk->length - offset_in_chunk, size)));
+  next_position_ = position + result;
+  NotifyClient(read_id, result, chunk->data.get() + offset_in_chunk);
+
+  if (!sequential || chunk->length < kChunkSize) {
+    read_ahead_until_ = chunk->offset + kChunkSize;
+    return;
+  }
+  // Keep the rest of the ring filled ahead of the reader. Each chunk is its
+  // own task so a read queued meanwhile isn't stuck behind the whole batch.
+  int64_t read_ahead_end =
+      chunk->offset + static_cast<int64_t>(kChunkSize) * kRingSize;
+  for (int64_t offset = std::max(read_ahead_until_, chunk->offset + kChunkSize);
+       offset < read_ahead_end; offset += kChunkSize) {
+    task_runner_->PostTask(
+        FROM_HERE,
+        base::Bind(&DirectFileReader::ReadAheadOnSequence, this, offset));
+  }
+  read_ahead_until_ = std::max(read_ahead_until_, read_ahead_end);
+}
+
+void DirectFileReader::ReadAheadOnSequence(int64_t offset) {
+  DCHECK(task_runner_->RunsTasksInCurrentSequence());
+  // Don't read ahead of a reader which moved elsewhere meanwhile.
+  if (offset < next_position_ ||
+      offset >= next_position_ + static_cast<int64_t>(kChunkSize) * kRingSize) {
+    return;
+  }
+  GetChunk(offset);
+}
+
+DirectFileReader::Chunk* DirectFileReader::FindChunk(int64_t offset) {
+  for (const auto& chunk : ring_) {
+    if (chunk->offset != -1 && offset >= chunk->offset &&
+        offset < chunk->offset + kChunkSize) {
+      return chunk.get();
+    }
+  }
+  return nullptr;
+}
+
+DirectFileReader::Chunk* DirectFileReader::GetChunk(int64_t offset) {
+  Chunk* chunk = FindChunk(offset);
+  // A short chunk read at the old end of a growing file is read again once
+  // a reader asks beyond it.
+  if (!chunk || offset >= chunk->offset + chunk->length) {
+    if (!chunk) {
+      chunk = std::min_element(ring_.begin(), ring_.end(),
+                               [](const std::unique_ptr<Chunk>& a,
+                                  const std::unique_ptr<Chunk>& b) {
+                                 return a->last_use < b->last_use;
+                               })
+                  ->get();
+    }
+    chunk->offset = offset - offset % kChunkSize;
+    // A single aligned pread(). At the end of the file it comes back short,
+    // which is the only short read direct I/O produces.
+    int result = file().ReadNoBestEffort(
+        chunk->offset, reinterpret_cast<char*>(chunk->data.get()), kChunkSize);
+    if (result < 0) {
+      PLOG(ERROR) << "Direct read at " << chunk->offset << " failed";
+      chunk->offset = -1;
+      return nullptr;
+    }
+    chunk->length = result;
+  }
+  chunk->last_use = ++use_counter_;
+  return chunk;
+}
+
+}  // namespace media
@@ -0,0 +1,72 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_DIRECT_FILE_READER_H_
+#define CHROMIUM_MEDIA_LIB_DIRECT_FILE_READER_H_
+
+#include <memory>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/memory/aligned_memory.h"
+#include "base/sequenced_task_runner.h"
+#include "chromium_media_lib/positioned_file_reader.h"
+
+namespace media {
+
+// Reads a file with O_DIRECT so that data which is read once does not evict
+// anything from the page cache. Reads go through aligned bounce buffers which
+// also form a small ring: sequential readers are served from chunks read
+// ahead of them, so throughput doesn't suffer from bypassing the kernel's
+// read-ahead. All I/O runs on one blocking sequence which owns the ring.
+class DirectFileReader : public PositionedFileReader {
+ public:
+  // Opens |path| for direct I/O. Falls back to buffered I/O on filesystems
+  // without O_DIRECT support, e.g. tmpfs.
+  static base::File OpenFile(const base::FilePath& path);
+
+  DirectFileReader(base::File file, Client* client);
+
+  // PositionedFileReader implementation.
+  void Read(int read_id, int64_t position, int size) override;
+
+ private:
+  struct Chunk {
+    Chunk();
+    ~Chunk();
+
+    std::unique_ptr<uint8_t, base::AlignedFreeDeleter> data;
+    // File offset of |data|, -1 while the chunk is unused.
+    int64_t offset;
+    int length;
+    // Larger is more recently used.
+    int64_t last_use;
+  };
+
+  ~DirectFileReader() override;
+
+  void ReadOnSequence(int read_id, int64_t position, int size);
+  void ReadAheadOnSequence(int64_t offset);
+
+  // Returns the chunk holding |offset|, reading it into the least recently
+  // used slot if necessary. A cached chunk which ends before |offset| is
+  // read again. Returns nullptr on I/O errors.
+  Chunk* GetChunk(int64_t offset);
+  Chunk* FindChunk(int64_t offset);
+
+  const scoped_refptr<base::SequencedTaskRunner> task_runner_;
+
+  // Only accessed on |task_runner_|.
+  std::vector<std::unique_ptr<Chunk>> ring_;
+  int64_t use_counter_;
+  // Where the next read starts if the reader is sequential.
+  int64_t next_position_;
+  // Chunks before this offset were already scheduled for read-ahead.
+  int64_t read_ahead_until_;
+
+  DISALLOW_COPY_AND_ASSIGN(DirectFileReader);
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_DIRECT_FILE_READER_H_
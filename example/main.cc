@@ -11,6 +11,7 @@
 #include "base/task_scheduler/task_scheduler.h"
 #include "base/threading/thread.h"
 #include "base/run_loop.h"
+#include "base/strings/string_split.h"
 #include "chromium_media_lib/media_context.h"
 #include "url/gurl.h"
 
@@ -32,7 +33,10 @@ class VideoFrameObserver
 
 struct MainParams {
   std::string media_file_;
+  std::vector<base::FilePath> media_segments_;
   GURL resource_file_;
+  base::FilePath http_cache_dir_;
+  int http_cache_max_bytes_;
   std::unique_ptr<base::Thread> media_thread;
   std::unique_ptr<base::Thread> io_thread;
   std::unique_ptr<base::Thread> worker_thread;
@@ -53,9 +57,15 @@ void init(MainParams* params) {
       params->worker_thread->task_runner(),
       std::move(media_log));
   media_params.SetVideoRendererSinkClient(params->video_renderer_.get());
+  if (!params->http_cache_dir_.empty()) {
+    media_params.SetHttpDiskCache(params->http_cache_dir_,
+                                  params->http_cache_max_bytes_);
+  }
   params->player =
       base::MakeUnique<media::MediaPlayerImpl>(media_params);
-  if (params->media_file_.empty())
+  if (!params->media_segments_.empty())
+    params->player->Load(params->media_segments_);
+  else if (params->media_file_.empty())
     params->player->Load(params->resource_file_);
   else
     params->player->Load(base::FilePath(params->media_file_));
@@ -68,17 +78,30 @@ int main(int argc, const char* argv[]) {
   base::CommandLine::Init(argc, argv);
   const char media_file[] = "media-file";
   const char resource_file[] = "resource-file";
+  const char media_segments[] = "media-segments";
+  const char http_cache_dir[] = "http-cache-dir";
 
   base::CommandLine* command_line = base::CommandLine::ForCurrentProcess();
-  if (!command_line->HasSwitch(media_file) && !command_line->HasSwitch(resource_file)) {
+  if (!command_line->HasSwitch(media_file) &&
+      !command_line->HasSwitch(resource_file) &&
+      !command_line->HasSwitch(media_segments)) {
     LOG(INFO) << "Usage:\n ./media_example --media-file=<file full path>";
     return 0;
   }
   MainParams params;
-  if (command_line->HasSwitch(media_file))
+  if (command_line->HasSwitch(media_segments)) {
+    for (const std::string& segment : base::SplitString(
+             command_line->GetSwitchValueASCII(media_segments), ",",
+             base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY)) {
+      params.media_segments_.push_back(base::FilePath(segment));
+    }
+  } else if (command_line->HasSwitch(media_file)) {
     params.media_file_ = command_line->GetSwitchValueASCII(media_file);
-  else
+  } else {
     params.resource_file_ = GURL(command_line->GetSwitchValueASCII(resource_file));
+  }
+  params.http_cache_dir_ = command_line->GetSwitchValuePath(http_cache_dir);
+  params.http_cache_max_bytes_ = 512 * 1024 * 1024;
   params.media_thread.reset(new base::Thread("Media"));
   params.io_thread.reset(new base::Thread("IO"));
   params.worker_thread.reset(new base::Thread("Worker"));
@@ -6,31 +6,74 @@
 #include "base/callback_helpers.h"
 #include "base/location.h"
 #include "base/macros.h"
+#include "base/memory/ptr_util.h"
+#include "chromium_media_lib/direct_file_reader.h"
 
 namespace media {
 
+FileDataSource::Options::Options()
+    : backend(kMemoryMapped),
+      inline_reads(false),
+      prefetch_window(4 * 1024 * 1024),
+      release_window(64 * 1024 * 1024),
+      follow_growing_file(false) {}
+
 FileDataSource::FileDataSource(
     const base::FilePath& path,
-    const scoped_refptr<base::SingleThreadTaskRunner>& task_runner)
+    const scoped_refptr<base::SingleThreadTaskRunner>& task_runner,
+    const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner,
+    const Options& options)
     : render_task_runner_(task_runner),
+      io_task_runner_(io_task_runner),
+      options_(options),
       path_(path),
       total_bytes_(-1),
       stop_signal_received_(false),
+      file_closed_(false),
       weak_factory_(this) {
   weak_ptr_ = weak_factory_.GetWeakPtr();
 }
 
-FileDataSource::~FileDataSource() {}
+FileDataSource::~FileDataSource() {
+  if (file_watcher_)
+    file_watcher_->Stop();
+  if (file_reader_)
+    file_reader_->Detach();
+}
 
 void FileDataSource::Initialize(const InitializeCB& init_cb) {
   DCHECK(render_task_runner_->BelongsToCurrentThread());
   DCHECK(!init_cb.is_null());
-  bool success = mapped_file_.Initialize(
-      base::File(path_, base::File::FLAG_OPEN | base::File::FLAG_READ));
+  bool success = false;
+  if (options_.backend == Options::kDirectIO) {
+    base::File file = DirectFileReader::OpenFile(path_);
+    if (file.IsValid())
+      file_reader_ = new DirectFileReader(std::move(file), this);
+  } else {
+    base::File file(path_, base::File::FLAG_OPEN | base::File::FLAG_READ);
+    if (options_.backend == Options::kPositionedRead ||
+        options_.follow_growing_file) {
+      if (file.IsValid())
+        file_reader_ = new PositionedFileReader(std::move(file), this);
+    } else {
+      success = mapped_file_.Initialize(std::move(file));
+    }
+  }
   {
     base::AutoLock auto_lock(lock_);
-    if (success)
+    if (file_reader_) {
+      total_bytes_ = file_reader_->GetLength();
+      success = total_bytes_ >= 0;
+    } else if (success) {
       total_bytes_ = mapped_file_.length();
+      advisor_.reset(new MappedFileAdvisor(
+          mapped_file_.data(), total_bytes_, options_.prefetch_window,
+          options_.release_window));
+    }
+  }
+  if (success && options_.follow_growing_file) {
+    file_watcher_ = new GrowingFileWatcher(path_, this, io_task_runner_);
+    file_watcher_->Start();
   }
   init_cb_ = init_cb;
   render_task_runner_->PostTask(
@@ -40,11 +83,15 @@ void FileDataSource::Initialize(const InitializeCB& init_cb) {
 void FileDataSource::Stop() {
   base::AutoLock auto_lock(lock_);
   stop_signal_received_ = true;
+  waiting_read_ids_.clear();
+  read_ops_.RunAll(kReadError);
 }
 
 void FileDataSource::Abort() {
+  // Only the pending reads are aborted, future reads are still served.
   base::AutoLock auto_lock(lock_);
-  stop_signal_received_ = true;
+  waiting_read_ids_.clear();
+  read_ops_.RunAll(kAborted);
 }
 
 void FileDataSource::Read(int64_t position,
@@ -52,25 +99,34 @@ void FileDataSource::Read(int64_t position,
                           uint8_t* data,
                           const DataSource::ReadCB& read_cb) {
   DCHECK(!read_cb.is_null());
+  if (!file_reader_ && options_.inline_reads) {
+    ReadInline(position, size, data, read_cb);
+    return;
+  }
+  int read_id;
   {
     base::AutoLock auto_lock(lock_);
-    DCHECK(!read_op_);
-
     if (stop_signal_received_) {
       read_cb.Run(kReadError);
       return;
     }
 
-    read_op_.reset(new ReadOperation(position, size, data, read_cb));
+    read_id = read_ops_.Add(
+        base::MakeUnique<ReadOperation>(position, size, data, read_cb));
+    if (file_reader_) {
+      StartFileRead(read_id);
+      return;
+    }
   }
   render_task_runner_->PostTask(
-      FROM_HERE,
-      base::Bind(&FileDataSource::ReadTask, weak_factory_.GetWeakPtr()));
+      FROM_HERE, base::Bind(&FileDataSource::ReadTask,
+                            weak_factory_.GetWeakPtr(), read_id));
 }
 
 bool FileDataSource::GetSize(int64_t* size_out) {
   base::AutoLock auto_lock(lock_);
-  if (total_bytes_ != -1) {
+  // The size of a growing file is only known once it was closed.
+  if (total_bytes_ != -1 && (!options_.follow_growing_file || file_closed_)) {
     *size_out = total_bytes_;
     return true;
   }
@@ -79,32 +135,105 @@ bool FileDataSource::GetSize(int64_t* size_out) {
 }
 
 bool FileDataSource::IsStreaming() {
-  return false;
+  return options_.follow_growing_file;
 }
 
 void FileDataSource::SetBitrate(int bitrate) {
   // Do nothing
 }
 
-void FileDataSource::ReadTask() {
-  DCHECK(render_task_runner_->BelongsToCurrentThread());
+void FileDataSource::OnFileRead(int read_id,
+                                int result,
+                                const uint8_t* data) {
+  base::AutoLock auto_lock(lock_);
+  // The read may have been completed by Stop() or Abort() in the meantime.
+  if (!read_ops_.Get(read_id))
+    return;
+  // A growing file may not have been flushed up to the length seen by
+  // OnFileChanged() yet, wait for the next change.
+  if (result == 0 && options_.follow_growing_file && !file_closed_) {
+    waiting_read_ids_.push_back(read_id);
+    return;
+  }
+  std::unique_ptr<ReadOperation> read_op = read_ops_.Take(read_id);
+  if (result > 0)
+    memcpy(read_op->data(), data, result);
+  ReadOperation::Run(std::move(read_op), result);
+}
+
+void FileDataSource::OnFileChanged(bool closed) {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
   base::AutoLock auto_lock(lock_);
-  if (stop_signal_received_ || !read_op_)
+  if (stop_signal_received_)
     return;
+  total_bytes_ = std::max(total_bytes_, file_reader_->GetLength());
+  file_closed_ = closed;
+  std::vector<int> waiting_read_ids;
+  waiting_read_ids.swap(waiting_read_ids_);
+  for (int read_id : waiting_read_ids) {
+    if (read_ops_.Get(read_id))
+      StartFileRead(read_id);
+  }
+}
 
-  DCHECK(read_op_->size());
-  if (mapped_file_.IsValid()) {
-    const uint8_t* file_data = mapped_file_.data();
-    int64_t available = total_bytes_ - read_op_->position();
-    if (available > 0) {
-      int bytes_read = static_cast<int>(
-          std::min<int64_t>(available, static_cast<int64_t>(read_op_->size())));
-      memcpy(read_op_->data(), file_data + read_op_->position(), bytes_read);
-      ReadOperation::Run(std::move(read_op_), bytes_read);
+void FileDataSource::StartFileRead(int read_id) {
+  lock_.AssertAcquired();
+  ReadOperation* read_op = read_ops_.Get(read_id);
+  DCHECK(read_op);
+  if (options_.follow_growing_file && read_op->position() >= total_bytes_) {
+    if (!file_closed_) {
+      waiting_read_ids_.push_back(read_id);
       return;
     }
+    // End of stream.
+    ReadOperation::Run(read_ops_.Take(read_id), 0);
+    return;
+  }
+  file_reader_->Read(read_id, read_op->position(), read_op->size());
+}
+
+void FileDataSource::ReadTask(int read_id) {
+  DCHECK(render_task_runner_->BelongsToCurrentThread());
+  base::AutoLock auto_lock(lock_);
+  std::unique_ptr<ReadOperation> read_op = read_ops_.Take(read_id);
+  if (stop_signal_received_ || !read_op)
+    return;
+
+  DCHECK(read_op->size());
+  int result = CopyFromMappedFile(read_op->position(), read_op->size(),
+                                  read_op->data());
+  ReadOperation::Run(std::move(read_op), result);
+}
+
+void FileDataSource::ReadInline(int64_t position,
+                                int size,
+                                uint8_t* data,
+                                const DataSource::ReadCB& read_cb) {
+  // The mapping is immutable once Initialize() has completed, so the copy can
+  // happen on the demuxer thread. |lock_| only orders it against Stop().
+  int result = kReadError;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (!stop_signal_received_)
+      result = CopyFromMappedFile(position, size, data);
   }
-  ReadOperation::Run(std::move(read_op_), kReadError);
+  read_cb.Run(result);
+}
+
+int FileDataSource::CopyFromMappedFile(int64_t position,
+                                       int size,
+                                       uint8_t* data) {
+  lock_.AssertAcquired();
+  if (!mapped_file_.IsValid() || position < 0)
+    return kReadError;
+  int64_t available = total_bytes_ - position;
+  if (available <= 0)
+    return kReadError;
+  int bytes_read = static_cast<int>(
+      std::min<int64_t>(available, static_cast<int64_t>(size)));
+  advisor_->OnRead(position, bytes_read);
+  memcpy(data, mapped_file_.data() + position, bytes_read);
+  return bytes_read;
 }
 
 }  // namespace media
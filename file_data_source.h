@@ -4,6 +4,7 @@
 #define CHROMIUM_MEDIA_LIB_FILE_DATA_SOURCE_H_
 
 #include <memory>
+#include <vector>
 
 #include "base/callback.h"
 #include "base/files/file_path.h"
@@ -12,16 +13,58 @@
 #include "base/memory/weak_ptr.h"
 #include "base/single_thread_task_runner.h"
 #include "base/synchronization/lock.h"
+#include "chromium_media_lib/growing_file_watcher.h"
+#include "chromium_media_lib/mapped_file_advisor.h"
+#include "chromium_media_lib/positioned_file_reader.h"
 #include "chromium_media_lib/read_operation.h"
 #include "media/base/data_source.h"
 
 namespace media {
 
-class FileDataSource : public DataSource {
+class FileDataSource : public DataSource,
+                       public PositionedFileReader::Client,
+                       public GrowingFileWatcher::Client {
  public:
+  struct Options {
+    Options();
+
+    enum Backend {
+      // Map the whole file with base::MemoryMappedFile.
+      kMemoryMapped,
+      // Serve reads with pread() on the blocking worker pool. Avoids mapping
+      // huge files and SIGBUS when the file is truncated under us.
+      kPositionedRead,
+      // Like kPositionedRead but with O_DIRECT, through aligned bounce
+      // buffers and a small read-ahead ring. Leaves the page cache alone,
+      // meant for batch processing of large archives read only once.
+      kDirectIO,
+    };
+    Backend backend;
+
+    // Only used by kMemoryMapped. Serve reads against the mapped file
+    // directly on the calling (demuxer) thread and run the ReadCB there,
+    // instead of posting to the render thread for every read.
+    bool inline_reads;
+
+    // Only used by kMemoryMapped. Paging hints for the mapped file, in
+    // bytes. Sequential readers get |prefetch_window| ahead of them
+    // prefetched, and pages more than |release_window| behind them dropped
+    // from the resident set. Zero disables the hint.
+    int64_t prefetch_window;
+    int64_t release_window;
+
+    // The file is still being written. IsStreaming() is reported, reads
+    // beyond the current end wait until the data is appended and the stream
+    // ends once the writer closes the file. Implies kPositionedRead unless
+    // kDirectIO is selected.
+    bool follow_growing_file;
+  };
+
   FileDataSource(
       const base::FilePath& path,
-      const scoped_refptr<base::SingleThreadTaskRunner>& task_runner);
+      const scoped_refptr<base::SingleThreadTaskRunner>& task_runner,
+      const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner,
+      const Options& options);
   ~FileDataSource() override;
 
   typedef base::Callback<void(bool)> InitializeCB;
@@ -40,19 +83,46 @@ class FileDataSource : public DataSource {
   bool IsStreaming() override;
   void SetBitrate(int bitrate) override;
 
+  // PositionedFileReader::Client implementation.
+  void OnFileRead(int read_id, int result, const uint8_t* data) override;
+
+  // GrowingFileWatcher::Client implementation.
+  void OnFileChanged(bool closed) override;
+
  private:
-  void ReadTask();
+  void ReadTask(int read_id);
+  void ReadInline(int64_t position,
+                  int size,
+                  uint8_t* data,
+                  const DataSource::ReadCB& read_cb);
+  // Copies from |mapped_file_| into |data| and returns the bytes copied or
+  // kReadError. |lock_| must be held.
+  int CopyFromMappedFile(int64_t position, int size, uint8_t* data);
+  // Hands |read_id| to |file_reader_|, or parks it until the file grows if
+  // it starts beyond the current end. |lock_| must be held.
+  void StartFileRead(int read_id);
 
  private:
   const scoped_refptr<base::SingleThreadTaskRunner> render_task_runner_;
+  const scoped_refptr<base::SingleThreadTaskRunner> io_task_runner_;
+  const Options options_;
   base::FilePath path_;
   base::MemoryMappedFile mapped_file_;
+  std::unique_ptr<MappedFileAdvisor> advisor_;
+  scoped_refptr<PositionedFileReader> file_reader_;
+  scoped_refptr<GrowingFileWatcher> file_watcher_;
   int64_t total_bytes_;
   base::Lock lock_;
   bool stop_signal_received_;
   InitializeCB init_cb_;
 
-  std::unique_ptr<ReadOperation> read_op_;
+  // Reads in flight, keyed by the id also handed to |file_reader_| so that
+  // a completion for an aborted read is dropped.
+  ReadOperationQueue read_ops_;
+  // Reads waiting for a growing file to reach them.
+  std::vector<int> waiting_read_ids_;
+  // The writer of a growing file closed it.
+  bool file_closed_;
 
   base::WeakPtr<FileDataSource> weak_ptr_;
   base::WeakPtrFactory<FileDataSource> weak_factory_;
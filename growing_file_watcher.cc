@@ -0,0 +1,117 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#include "chromium_media_lib/growing_file_watcher.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+
+namespace media {
+
+namespace {
+
+const uint32_t kWatchMask =
+    IN_MODIFY | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF;
+// Events after which nothing more will be appended to the file.
+const uint32_t kClosedMask =
+    IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED;
+
+}  // namespace
+
+GrowingFileWatcher::GrowingFileWatcher(
+    const base::FilePath& path,
+    Client* client,
+    const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner)
+    : path_(path),
+      io_task_runner_(io_task_runner),
+      closed_(false),
+      client_(client) {}
+
+GrowingFileWatcher::~GrowingFileWatcher() {
+  DCHECK(!controller_);
+}
+
+void GrowingFileWatcher::Start() {
+  io_task_runner_->PostTask(
+      FROM_HERE, base::Bind(&GrowingFileWatcher::StartOnIOThread, this));
+}
+
+void GrowingFileWatcher::Stop() {
+  {
+    base::AutoLock auto_lock(lock_);
+    client_ = nullptr;
+  }
+  io_task_runner_->PostTask(
+      FROM_HERE, base::Bind(&GrowingFileWatcher::StopOnIOThread, this));
+}
+
+void GrowingFileWatcher::StartOnIOThread() {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
+  inotify_fd_.reset(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+  if (!inotify_fd_.is_valid() ||
+      inotify_add_watch(inotify_fd_.get(), path_.value().c_str(),
+                        kWatchMask) < 0) {
+    PLOG(ERROR) << "Can't watch " << path_.value();
+    // Without notifications the file has to be treated as complete.
+    closed_ = true;
+    NotifyClient(closed_);
+    return;
+  }
+  controller_.reset(
+      new base::MessageLoopForIO::FileDescriptorWatcher(FROM_HERE));
+  base::MessageLoopForIO::current()->WatchFileDescriptor(
+      inotify_fd_.get(), true, base::MessageLoopForIO::WATCH_READ,
+      controller_.get(), this);
+  NotifyClient(closed_);
+}
+
+void GrowingFileWatcher::StopOnIOThread() {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
+  controller_.reset();
+  inotify_fd_.reset();
+}
+
+void GrowingFileWatcher::OnFileCanReadWithoutBlocking(int fd) {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
+  // Drain everything queued so a burst of writes yields one notification.
+  alignas(struct inotify_event) char buffer[4096];
+  bool changed = false;
+  while (true) {
+    ssize_t length = HANDLE_EINTR(read(fd, buffer, sizeof(buffer)));
+    if (length <= 0) {
+      if (length < 0 && errno != EAGAIN)
+        PLOG(ERROR) << "inotify read failed";
+      break;
+    }
+    for (char* p = buffer; p < buffer + length;) {
+      const struct inotify_event* event =
+          reinterpret_cast<const struct inotify_event*>(p);
+      if (event->mask & kClosedMask)
+        closed_ = true;
+      changed = true;
+      p += sizeof(struct inotify_event) + event->len;
+    }
+  }
+  if (closed_)
+    controller_.reset();
+  if (changed)
+    NotifyClient(closed_);
+}
+
+void GrowingFileWatcher::OnFileCanWriteWithoutBlocking(int fd) {
+  NOTREACHED();
+}
+
+void GrowingFileWatcher::NotifyClient(bool closed) {
+  base::AutoLock auto_lock(lock_);
+  if (client_)
+    client_->OnFileChanged(closed);
+}
+
+}  // namespace media
@@ -0,0 +1,75 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_GROWING_FILE_WATCHER_H_
+#define CHROMIUM_MEDIA_LIB_GROWING_FILE_WATCHER_H_
+
+#include <memory>
+
+#include "base/files/file_path.h"
+#include "base/files/scoped_file.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/message_loop/message_loop.h"
+#include "base/single_thread_task_runner.h"
+#include "base/synchronization/lock.h"
+
+namespace media {
+
+// Follows a file which is still being appended to. Uses inotify rather than
+// polling, base::FilePathWatcher is not used because it does not report
+// IN_MODIFY. Watches on |io_task_runner|, which must run a MessageLoopForIO,
+// and reports to its client on that thread.
+class GrowingFileWatcher
+    : public base::RefCountedThreadSafe<GrowingFileWatcher>,
+      public base::MessageLoopForIO::Watcher {
+ public:
+  class Client {
+   public:
+    // The file was written to. |closed| is set once the writer closed it,
+    // nothing more will be appended after that.
+    virtual void OnFileChanged(bool closed) = 0;
+  };
+
+  GrowingFileWatcher(
+      const base::FilePath& path,
+      Client* client,
+      const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner);
+
+  // May be called from any thread. The client is notified once right after
+  // the watch is set up, so changes made before that are not missed.
+  void Start();
+  // No OnFileChanged() is delivered once this returns, so the client may be
+  // destroyed afterwards.
+  void Stop();
+
+  // base::MessageLoopForIO::Watcher implementation.
+  void OnFileCanReadWithoutBlocking(int fd) override;
+  void OnFileCanWriteWithoutBlocking(int fd) override;
+
+ private:
+  friend class base::RefCountedThreadSafe<GrowingFileWatcher>;
+  ~GrowingFileWatcher() override;
+
+  void StartOnIOThread();
+  void StopOnIOThread();
+  void NotifyClient(bool closed);
+
+  const base::FilePath path_;
+  const scoped_refptr<base::SingleThreadTaskRunner> io_task_runner_;
+
+  // Only accessed on |io_task_runner_|.
+  base::ScopedFD inotify_fd_;
+  std::unique_ptr<base::MessageLoopForIO::FileDescriptorWatcher> controller_;
+  bool closed_;
+
+  // Held while |client_| is called, which makes Stop() a barrier against
+  // notifications running concurrently.
+  base::Lock lock_;
+  Client* client_;
+
+  DISALLOW_COPY_AND_ASSIGN(GrowingFileWatcher);
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_GROWING_FILE_WATCHER_H_
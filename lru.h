@@ -6,10 +6,13 @@
 #define MEDIA_BLINK_LRU_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
-#include <list>
+#include <algorithm>
+#include <functional>
+#include <vector>
 
-#include "base/containers/hash_tables.h"
+#include "base/logging.h"
 #include "base/macros.h"
 
 namespace media {
@@ -18,6 +21,9 @@ namespace media {
 // Keeps track of a set of data and lets you get the least recently used
 // (oldest) element at any time. All operations are O(1). Elements are expected
 // to be hashable and unique.
+// Elements live in an array of nodes linked by index, found through an open
+// addressing table of node indices. Both only grow when the LRU holds more
+// elements than ever before, so a LRU of stable size doesn't allocate.
 // Example:
 //  LRU<int> lru;
 //  lru.Insert(1);
@@ -28,64 +34,204 @@ namespace media {
 template <typename T>
 class LRU {
  public:
-  LRU() {}
+  LRU() : head_(kNone), tail_(kNone), free_(kNone), size_(0) {}
 
   // Adds |x| to LRU.
   // |x| must not already be in the LRU.
   // Faster than Use(), and will DCHECK that |x| is not in the LRU.
   void Insert(const T& x) {
     DCHECK(!Contains(x));
-    lru_.push_front(x);
-    pos_[x] = lru_.begin();
+    if (free_ == kNone)
+      Grow();
+    int32_t node = free_;
+    free_ = nodes_[node].next;
+    nodes_[node].value = x;
+    Link(node);
+    AddSlot(node);
+    ++size_;
   }
 
   // Removes |x| from LRU.
   // |x| must be in the LRU.
   void Remove(const T& x) {
-    DCHECK(Contains(x));
-    lru_.erase(pos_[x]);
-    pos_.erase(x);
+    size_t slot;
+    bool found = FindSlot(x, &slot);
+    DCHECK(found);
+    int32_t node = slots_[slot];
+    RemoveSlot(slot);
+    Unlink(node);
+    nodes_[node].next = free_;
+    free_ = node;
+    --size_;
   }
 
   // Moves |x| to front of LRU. (most recently used)
   // If |x| is not in LRU, it is added.
   // Please call Insert() if you know that |x| is not in the LRU.
   void Use(const T& x) {
-    if (Contains(x))
-      Remove(x);
-    Insert(x);
+    size_t slot;
+    if (!FindSlot(x, &slot)) {
+      Insert(x);
+      return;
+    }
+    int32_t node = slots_[slot];
+    if (node == head_)
+      return;
+    Unlink(node);
+    Link(node);
   }
 
-  bool Empty() const { return lru_.empty(); }
+  bool Empty() const { return !size_; }
 
   // Returns the Least Recently Used T and removes it.
   T Pop() {
     DCHECK(!Empty());
-    T ret = lru_.back();
-    lru_.pop_back();
-    pos_.erase(ret);
+    T ret = nodes_[tail_].value;
+    Remove(ret);
     return ret;
   }
 
   // Returns the Least Recently Used T _without_ removing it.
   T Peek() const {
     DCHECK(!Empty());
-    return lru_.back();
+    return nodes_[tail_].value;
   }
 
-  bool Contains(const T& x) const { return pos_.find(x) != pos_.end(); }
+  // Finds the least recently used T for which |pred| returns true, without
+  // removing it. Returns false if there is none.
+  template <typename Predicate>
+  bool FindOldest(Predicate pred, T* x) const {
+    for (int32_t node = tail_; node != kNone; node = nodes_[node].prev) {
+      if (pred(nodes_[node].value)) {
+        *x = nodes_[node].value;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool Contains(const T& x) const {
+    size_t slot;
+    return FindSlot(x, &slot);
+  }
 
-  size_t Size() const { return pos_.size(); }
+  size_t Size() const { return size_; }
 
  private:
   friend class LRUTest;
 
-  // Linear list of elements, most recently used first.
-  std::list<T> lru_;
+  static const int32_t kNone = -1;
+  static const size_t kMinNodes = 16;
+
+  struct Node {
+    T value;
+    // Neighbours towards the most and the least recently used end, or the
+    // next free node.
+    int32_t prev;
+    int32_t next;
+  };
+
+  // std::hash of integers is the identity, which would put runs of
+  // consecutive block ids in one probe cluster that every removal walks.
+  // Mixes the bits so that the low ones, which pick the slot, depend on all
+  // of them.
+  static size_t Hash(const T& x) {
+    uint64_t h = std::hash<T>()(x);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+  }
+
+  // Makes |node| the most recently used.
+  void Link(int32_t node) {
+    nodes_[node].prev = kNone;
+    nodes_[node].next = head_;
+    if (head_ != kNone)
+      nodes_[head_].prev = node;
+    head_ = node;
+    if (tail_ == kNone)
+      tail_ = node;
+  }
+
+  void Unlink(int32_t node) {
+    int32_t prev = nodes_[node].prev;
+    int32_t next = nodes_[node].next;
+    if (prev != kNone)
+      nodes_[prev].next = next;
+    else
+      head_ = next;
+    if (next != kNone)
+      nodes_[next].prev = prev;
+    else
+      tail_ = prev;
+  }
+
+  bool FindSlot(const T& x, size_t* slot) const {
+    if (slots_.empty())
+      return false;
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = Hash(x) & mask; slots_[i] != kNone; i = (i + 1) & mask) {
+      if (nodes_[slots_[i]].value == x) {
+        *slot = i;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void AddSlot(int32_t node) {
+    const size_t mask = slots_.size() - 1;
+    size_t i = Hash(nodes_[node].value) & mask;
+    while (slots_[i] != kNone)
+      i = (i + 1) & mask;
+    slots_[i] = node;
+  }
+
+  // Empties |slot| and moves later entries of its probe sequence back, so
+  // that lookups need no tombstones.
+  void RemoveSlot(size_t slot) {
+    const size_t mask = slots_.size() - 1;
+    slots_[slot] = kNone;
+    for (size_t i = (slot + 1) & mask; slots_[i] != kNone;
+         i = (i + 1) & mask) {
+      size_t home = Hash(nodes_[slots_[i]].value) & mask;
+      // Stays if its home lies cyclically in (slot, i].
+      bool stays = slot < i ? (home > slot && home <= i)
+                            : (home > slot || home <= i);
+      if (stays)
+        continue;
+      slots_[slot] = slots_[i];
+      slots_[i] = kNone;
+      slot = i;
+    }
+  }
+
+  // Doubles the nodes and rebuilds the table, which is kept at most half
+  // full.
+  void Grow() {
+    DCHECK(free_ == kNone);
+    const size_t old_size = nodes_.size();
+    const size_t new_size = std::max(old_size * 2, size_t{kMinNodes});
+    nodes_.resize(new_size);
+    for (size_t i = new_size; i > old_size; --i) {
+      nodes_[i - 1].next = free_;
+      free_ = static_cast<int32_t>(i - 1);
+    }
+    slots_.assign(new_size * 2, int32_t{kNone});
+    for (int32_t node = head_; node != kNone; node = nodes_[node].next)
+      AddSlot(node);
+  }
+
+  // Elements and free nodes, linked by index.
+  std::vector<Node> nodes_;
+  int32_t head_;
+  int32_t tail_;
+  int32_t free_;
+  size_t size_;
 
-  // Maps element values to positions in the list so that we
-  // can quickly remove elements.
-  base::hash_map<T, typename std::list<T>::iterator> pos_;
+  // Open addressing table of node indices, a power of two in size.
+  std::vector<int32_t> slots_;
 
   DISALLOW_COPY_AND_ASSIGN(LRU);
 };
@@ -0,0 +1,108 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#include "chromium_media_lib/mapped_file_advisor.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/process/process_metrics.h"
+#include "build/build_config.h"
+
+#if defined(OS_POSIX)
+#include <sys/mman.h>
+#endif
+
+namespace media {
+
+namespace {
+
+// Demuxers skip small gaps between packets, so reads landing this close to
+// the expected position still count as sequential.
+const int64_t kSequentialSlack = 64 * 1024;
+// Prefetched right away at the target of a seek.
+const int64_t kSeekPrefetchSize = 256 * 1024;
+
+}  // namespace
+
+MappedFileAdvisor::MappedFileAdvisor(const uint8_t* data,
+                                     int64_t length,
+                                     int64_t prefetch_window,
+                                     int64_t release_window)
+    : data_(data),
+      length_(length),
+      prefetch_window_(prefetch_window),
+      release_window_(release_window),
+      page_size_(static_cast<int64_t>(base::GetPageSize())),
+      next_position_(0),
+      sequential_reads_(0),
+      released_until_(0),
+      prefetched_until_(0) {}
+
+MappedFileAdvisor::~MappedFileAdvisor() {}
+
+void MappedFileAdvisor::OnRead(int64_t position, int size) {
+  bool in_sequence = position >= next_position_ - kSequentialSlack &&
+                     position <= next_position_ + kSequentialSlack;
+  next_position_ = position + size;
+  if (!in_sequence) {
+    sequential_reads_ = 0;
+    released_until_ = std::min(
+        released_until_, std::max<int64_t>(0, position - release_window_));
+    prefetched_until_ = position;
+    if (prefetch_window_) {
+      Prefetch(position,
+               position + std::min(kSeekPrefetchSize, prefetch_window_));
+    }
+    return;
+  }
+
+  if (!sequential()) {
+    ++sequential_reads_;
+    return;
+  }
+
+  // Top up the window ahead of the reader once half of it was consumed, so
+  // madvise() runs once per half window rather than once per read.
+  if (prefetch_window_ &&
+      prefetched_until_ - next_position_ < prefetch_window_ / 2) {
+    int64_t begin = std::max(prefetched_until_, next_position_);
+    Prefetch(begin, next_position_ + prefetch_window_);
+  }
+
+  if (release_window_) {
+    int64_t release_end = position - release_window_;
+    if (release_end - released_until_ >= release_window_ / 4)
+      Release(released_until_, release_end);
+  }
+}
+
+void MappedFileAdvisor::Prefetch(int64_t begin, int64_t end) {
+  end = std::min(end, length_);
+  begin = begin & ~(page_size_ - 1);
+  if (begin >= end)
+    return;
+#if defined(OS_POSIX)
+  if (madvise(const_cast<uint8_t*>(data_) + begin,
+              static_cast<size_t>(end - begin), MADV_WILLNEED)) {
+    DPLOG(ERROR) << "madvise(MADV_WILLNEED) failed";
+  }
+#endif
+  prefetched_until_ = std::max(prefetched_until_, end);
+}
+
+void MappedFileAdvisor::Release(int64_t begin, int64_t end) {
+  // Only whole pages which are entirely behind the reader are dropped.
+  begin = (begin + page_size_ - 1) & ~(page_size_ - 1);
+  end = std::min(end, length_) & ~(page_size_ - 1);
+  if (begin >= end)
+    return;
+#if defined(OS_POSIX)
+  if (madvise(const_cast<uint8_t*>(data_) + begin,
+              static_cast<size_t>(end - begin), MADV_DONTNEED)) {
+    DPLOG(ERROR) << "madvise(MADV_DONTNEED) failed";
+  }
+#endif
+  released_until_ = end;
+}
+
+}  // namespace media
@@ -0,0 +1,58 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_MAPPED_FILE_ADVISOR_H_
+#define CHROMIUM_MEDIA_LIB_MAPPED_FILE_ADVISOR_H_
+
+#include <stdint.h>
+
+#include "base/macros.h"
+
+namespace media {
+
+// Tracks the positions read from a memory-mapped file and gives the kernel
+// paging hints: pages in a window ahead of a sequential reader are
+// prefetched (MADV_WILLNEED) and pages far behind it are dropped from the
+// resident set (MADV_DONTNEED). After a seek a small window around the new
+// position is prefetched so the first reads don't take major faults.
+// Not thread safe, callers serialize OnRead().
+class MappedFileAdvisor {
+ public:
+  // A zero window disables the corresponding hint.
+  MappedFileAdvisor(const uint8_t* data,
+                    int64_t length,
+                    int64_t prefetch_window,
+                    int64_t release_window);
+  ~MappedFileAdvisor();
+
+  void OnRead(int64_t position, int size);
+
+  bool sequential() const { return sequential_reads_ >= kSequentialThreshold; }
+
+ private:
+  // Number of back-to-back reads before the access pattern is treated as
+  // sequential.
+  static const int kSequentialThreshold = 3;
+
+  void Prefetch(int64_t begin, int64_t end);
+  void Release(int64_t begin, int64_t end);
+
+  const uint8_t* data_;
+  const int64_t length_;
+  const int64_t prefetch_window_;
+  const int64_t release_window_;
+  const int64_t page_size_;
+
+  // Where the next read starts if the reader is sequential.
+  int64_t next_position_;
+  int sequential_reads_;
+  // Everything in [0, released_until_) was already released, everything in
+  // [next_position_, prefetched_until_) was already prefetched.
+  int64_t released_until_;
+  int64_t prefetched_until_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedFileAdvisor);
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_MAPPED_FILE_ADVISOR_H_
@@ -12,7 +12,9 @@
 #include "base/callback_helpers.h"
 #include "base/memory/ptr_util.h"
 #include "chromium_media_lib/audio_device_factory.h"
+#include "chromium_media_lib/custom_data_source.h"
 #include "chromium_media_lib/media_context.h"
+#include "chromium_media_lib/resource_fetcher.h"
 #include "media/base/bind_to_current_loop.h"
 #include "media/filters/ffmpeg_demuxer.h"
 #include "media/renderers/default_renderer_factory.h"
@@ -42,10 +44,18 @@ MediaPlayerImpl::MediaPlayerImpl(MediaPlayerParams& params)
           base::Bind(&MediaPlayerImpl::OnPipelineSuspended, AsWeakPtr()),
           base::Bind(&MediaPlayerImpl::OnBeforePipelineResume, AsWeakPtr()),
           base::Bind(&MediaPlayerImpl::OnPipelineResumed, AsWeakPtr()),
-          base::Bind(&MediaPlayerImpl::OnError, AsWeakPtr())) {
+          base::Bind(&MediaPlayerImpl::OnError, AsWeakPtr())),
+      file_data_source_options_(params.file_data_source_options()),
+      read_cache_options_(params.read_cache_options()),
+      resource_buffer_options_(params.resource_buffer_options()) {
   if (params.video_renderer_sink_client())
     video_renderer_sink_->SetVideoRendererSinkClient(
         params.video_renderer_sink_client());
+  // Before any fetch of this player creates the request context.
+  if (!params.http_disk_cache_path().empty()) {
+    ResourceFetcher::EnableDiskCache(params.http_disk_cache_path(),
+                                     params.http_disk_cache_max_bytes());
+  }
   renderer_factory_ = base::MakeUnique<media::DefaultRendererFactory>(
       media_log_.get(), MediaContext::Get()->GetDecoderFactory(),
       DefaultRendererFactory::GetGpuFactoriesCB());
@@ -58,16 +68,51 @@ MediaPlayerImpl::MediaPlayerImpl(MediaPlayerParams& params)
 MediaPlayerImpl::~MediaPlayerImpl() {}
 
 void MediaPlayerImpl::Load(GURL url) {
-  resource_source_.reset(
-      new ResourceDataSource(url, main_task_runner_, io_task_runner_));
-  resource_source_->Initialize(
+  std::unique_ptr<ResourceDataSource> source(new ResourceDataSource(
+      url, main_task_runner_, io_task_runner_, resource_buffer_options_));
+  source->Initialize(
       base::Bind(&MediaPlayerImpl::DataSourceInitialized, AsWeakPtr()));
+  SetDataSource(std::move(source));
 }
 
 void MediaPlayerImpl::Load(const base::FilePath& path) {
-  data_source_.reset(new FileDataSource(path, main_task_runner_));
-  data_source_->Initialize(
+  std::unique_ptr<FileDataSource> source(
+      new FileDataSource(path, main_task_runner_, io_task_runner_,
+                         file_data_source_options_));
+  source->Initialize(
+      base::Bind(&MediaPlayerImpl::DataSourceInitialized, AsWeakPtr()));
+  SetDataSource(std::move(source));
+}
+
+void MediaPlayerImpl::Load(const std::vector<base::FilePath>& paths) {
+  std::unique_ptr<ConcatFileDataSource> source(new ConcatFileDataSource(
+      paths, main_task_runner_, file_data_source_options_));
+  source->Initialize(
       base::Bind(&MediaPlayerImpl::DataSourceInitialized, AsWeakPtr()));
+  SetDataSource(std::move(source));
+}
+
+void MediaPlayerImpl::Load(scoped_refptr<base::RefCountedMemory> buffer) {
+  data_source_.reset(new BufferDataSource(buffer));
+  main_task_runner_->PostTask(
+      FROM_HERE,
+      base::Bind(&MediaPlayerImpl::DataSourceInitialized, AsWeakPtr(), true));
+}
+
+void MediaPlayerImpl::Load(const uint8_t* data,
+                           size_t size,
+                           const base::Closure& release_cb) {
+  data_source_.reset(new BufferDataSource(data, size, release_cb));
+  main_task_runner_->PostTask(
+      FROM_HERE,
+      base::Bind(&MediaPlayerImpl::DataSourceInitialized, AsWeakPtr(), true));
+}
+
+void MediaPlayerImpl::Load(std::unique_ptr<CustomDataProvider> provider) {
+  SetDataSource(base::MakeUnique<CustomDataSource>(std::move(provider)));
+  main_task_runner_->PostTask(
+      FROM_HERE,
+      base::Bind(&MediaPlayerImpl::DataSourceInitialized, AsWeakPtr(), true));
 }
 
 void MediaPlayerImpl::Play() {
@@ -219,6 +264,15 @@ size_t MediaPlayerImpl::VideoDecodedByteCount() const {
 }
 
 
+void MediaPlayerImpl::SetDataSource(std::unique_ptr<DataSource> source) {
+  if (read_cache_options_.block_size > 0) {
+    data_source_.reset(
+        new CachingDataSource(std::move(source), read_cache_options_));
+  } else {
+    data_source_ = std::move(source);
+  }
+}
+
 void MediaPlayerImpl::DataSourceInitialized(bool success) {
   DCHECK(main_task_runner_->BelongsToCurrentThread());
   if (!success) {
@@ -229,7 +283,7 @@ void MediaPlayerImpl::DataSourceInitialized(bool success) {
 
 void MediaPlayerImpl::StartPipeline() {
   DCHECK(main_task_runner_->BelongsToCurrentThread());
-  DCHECK(data_source_ || resource_source_);
+  DCHECK(data_source_);
 
   Demuxer::EncryptedMediaInitDataCB encrypted_media_init_data_cb =
       BindToCurrentLoop(
@@ -239,12 +293,10 @@ void MediaPlayerImpl::StartPipeline() {
   Demuxer::MediaTracksUpdatedCB media_tracks_updated_cb = BindToCurrentLoop(
       base::Bind(&MediaPlayerImpl::OnFFmpegMediaTracksUpdated, AsWeakPtr()));
 
-  DataSource* source = data_source_ ? (DataSource*)data_source_.get()
-                                    : (DataSource*)resource_source_.get();
-  demuxer_.reset(new FFmpegDemuxer(media_task_runner_, source,
+  demuxer_.reset(new FFmpegDemuxer(media_task_runner_, data_source_.get(),
                                    encrypted_media_init_data_cb,
                                    media_tracks_updated_cb, media_log_.get()));
-  bool is_streaming = false;
+  bool is_streaming = data_source_->IsStreaming();
   pipeline_controller_.Start(demuxer_.get(), this, is_streaming, true);
 #else
   OnError(PipelineStatus::DEMUXER_ERROR_COULD_NOT_OPEN);
@@ -12,6 +12,9 @@
 #include "base/memory/ref_counted.h"
 #include "base/memory/weak_ptr.h"
 #include "chromium_media_lib/audiosourceprovider_impl.h"
+#include "chromium_media_lib/buffer_data_source.h"
+#include "chromium_media_lib/concat_file_data_source.h"
+#include "chromium_media_lib/custom_data_provider.h"
 #include "chromium_media_lib/file_data_source.h"
 #include "chromium_media_lib/mediaplayer_params.h"
 #include "chromium_media_lib/resource_data_source.h"
@@ -36,6 +39,16 @@ class MEDIA_EXPORT MediaPlayerImpl
   // Playback controls.
   void Load(GURL url);
   void Load(const base::FilePath& path);
+  // Plays |paths| back to back as one stream, e.g. a recording which was
+  // split into chunks.
+  void Load(const std::vector<base::FilePath>& paths);
+  // Plays media the application holds in memory, without going to disk.
+  // The player keeps a reference to |buffer|.
+  void Load(scoped_refptr<base::RefCountedMemory> buffer);
+  // |data| must stay valid until |release_cb| is run.
+  void Load(const uint8_t* data, size_t size, const base::Closure& release_cb);
+  // Plays bytes supplied by the application through |provider|.
+  void Load(std::unique_ptr<CustomDataProvider> provider);
   void Play();
   void Pause();
   bool SupportsSave() const;
@@ -70,6 +83,8 @@ class MEDIA_EXPORT MediaPlayerImpl
   size_t AudioDecodedByteCount() const override;
   size_t VideoDecodedByteCount() const override;
 
+  // Takes ownership of |source|, behind the read cache if it is enabled.
+  void SetDataSource(std::unique_ptr<DataSource> source);
   void DataSourceInitialized(bool success);
   void StartPipeline();
 
@@ -113,10 +128,12 @@ class MEDIA_EXPORT MediaPlayerImpl
   // |pipeline_controller_| owns an instance of Pipeline.
   PipelineController pipeline_controller_;
   GURL loaded_url_;
+  const FileDataSource::Options file_data_source_options_;
+  const CachingDataSource::Options read_cache_options_;
+  const ResourceMultiBuffer::Options resource_buffer_options_;
 
   std::unique_ptr<RendererFactory> renderer_factory_;
-  std::unique_ptr<FileDataSource> data_source_;
-  std::unique_ptr<ResourceDataSource> resource_source_;
+  std::unique_ptr<DataSource> data_source_;
   std::unique_ptr<Demuxer> demuxer_;
 
   DISALLOW_COPY_AND_ASSIGN(MediaPlayerImpl);
@@ -16,7 +16,8 @@ MediaPlayerParams::MediaPlayerParams(
       io_task_runner_(io_task_runner),
       worker_task_runner_(worker_task_runner),
       media_log_(std::move(media_log)),
-      video_renderer_sink_client_(nullptr) {}
+      video_renderer_sink_client_(nullptr),
+      http_disk_cache_max_bytes_(0) {}
 
 MediaPlayerParams::~MediaPlayerParams() {}
 
@@ -6,8 +6,12 @@
 
 #include <memory>
 
+#include "base/files/file_path.h"
 #include "base/memory/ref_counted.h"
 #include "base/single_thread_task_runner.h"
+#include "chromium_media_lib/caching_data_source.h"
+#include "chromium_media_lib/file_data_source.h"
+#include "chromium_media_lib/resource_multibuffer.h"
 #include "media/base/media_log.h"
 
 namespace media {
@@ -46,6 +50,48 @@ class MediaPlayerParams {
     return video_renderer_sink_client_;
   }
 
+  void SetFileDataSourceOptions(const FileDataSource::Options& options) {
+    file_data_source_options_ = options;
+  }
+
+  const FileDataSource::Options& file_data_source_options() const {
+    return file_data_source_options_;
+  }
+
+  void SetReadCacheOptions(const CachingDataSource::Options& options) {
+    read_cache_options_ = options;
+  }
+
+  const CachingDataSource::Options& read_cache_options() const {
+    return read_cache_options_;
+  }
+
+  // Options of the buffer of media fetched over HTTP. Players of the same
+  // URL share the cached blocks, |eviction_policy| only applies when no
+  // other player has the URL open, later players use the policy of the
+  // first.
+  void SetResourceBufferOptions(const ResourceMultiBuffer::Options& options) {
+    resource_buffer_options_ = options;
+  }
+
+  const ResourceMultiBuffer::Options& resource_buffer_options() const {
+    return resource_buffer_options_;
+  }
+
+  // Keeps media fetched over HTTP in a disk cache at |path| of up to
+  // |max_bytes|, so that it survives restarts of the process. The cache is
+  // shared by the whole process, it must be set on the first player
+  // created and later players can't change it.
+  void SetHttpDiskCache(const base::FilePath& path, int max_bytes) {
+    http_disk_cache_path_ = path;
+    http_disk_cache_max_bytes_ = max_bytes;
+  }
+
+  const base::FilePath& http_disk_cache_path() const {
+    return http_disk_cache_path_;
+  }
+  int http_disk_cache_max_bytes() const { return http_disk_cache_max_bytes_; }
+
  private:
   scoped_refptr<base::SingleThreadTaskRunner> main_task_runner_;
   scoped_refptr<base::SingleThreadTaskRunner> media_task_runner_;
@@ -53,6 +99,11 @@ class MediaPlayerParams {
   scoped_refptr<base::TaskRunner> worker_task_runner_;
   std::unique_ptr<MediaLog> media_log_;
   VideoRendererSinkClient* video_renderer_sink_client_;
+  FileDataSource::Options file_data_source_options_;
+  CachingDataSource::Options read_cache_options_;
+  ResourceMultiBuffer::Options resource_buffer_options_;
+  base::FilePath http_disk_cache_path_;
+  int http_disk_cache_max_bytes_;
 };
 
 }  // namespace media
@@ -0,0 +1,136 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_PAGED_TABLE_H_
+#define CHROMIUM_MEDIA_LIB_PAGED_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <utility>
+
+#include "base/containers/hash_tables.h"
+#include "base/logging.h"
+#include "base/macros.h"
+
+namespace media {
+
+// Table of elements indexed by dense, non negative integers, such as the
+// blocks of a resource. Indices are grouped into pages of 64 slots, which
+// are allocated on first use and freed once empty, so sparse regions left
+// behind by seeks cost nothing. A lookup is a shift, a hash lookup of the
+// page, skipped when it is the page of the previous lookup, and an array
+// access.
+// Example:
+//  PagedTable<int> table;
+//  table.Insert(1000, 7);
+//  cout << *table.Find(1000);  // this will print "7"
+template <typename T>
+class PagedTable {
+ public:
+  PagedTable() : size_(0), last_page_index_(-1), last_page_(nullptr) {}
+
+  // Returns the element at |index|, null if there is none.
+  T* Find(int64_t index) {
+    Page* page = FindPage(index >> kPageShift);
+    if (!page || !page->Contains(index & kPageMask))
+      return nullptr;
+    return &page->slots[index & kPageMask];
+  }
+
+  bool Contains(int64_t index) { return Find(index) != nullptr; }
+
+  // Adds |value| at |index|, which must be empty.
+  void Insert(int64_t index, T value) {
+    DCHECK_GE(index, 0);
+    DCHECK(!Contains(index));
+    const int64_t page_index = index >> kPageShift;
+    Page* page = FindPage(page_index);
+    if (!page) {
+      std::unique_ptr<Page>& entry = pages_[page_index];
+      entry.reset(new Page());
+      page = entry.get();
+      last_page_index_ = page_index;
+      last_page_ = page;
+    }
+    const int slot = static_cast<int>(index & kPageMask);
+    page->slots[slot] = std::move(value);
+    page->used |= uint64_t{1} << slot;
+    ++size_;
+  }
+
+  // Removes the element at |index|, which must be there, and returns it.
+  T Take(int64_t index) {
+    DCHECK(Contains(index));
+    const int64_t page_index = index >> kPageShift;
+    Page* page = FindPage(page_index);
+    const int slot = static_cast<int>(index & kPageMask);
+    T value = std::move(page->slots[slot]);
+    page->slots[slot] = T();
+    page->used &= ~(uint64_t{1} << slot);
+    --size_;
+    if (!page->used) {
+      if (last_page_ == page) {
+        last_page_index_ = -1;
+        last_page_ = nullptr;
+      }
+      pages_.erase(page_index);
+    }
+    return value;
+  }
+
+  // Calls |visitor| with every element.
+  template <typename Visitor>
+  void ForEach(Visitor visitor) {
+    for (auto& entry : pages_) {
+      Page* page = entry.second.get();
+      for (int slot = 0; slot < kPageSize; ++slot) {
+        if (page->Contains(slot))
+          visitor(page->slots[slot]);
+      }
+    }
+  }
+
+  bool Empty() const { return !size_; }
+
+  size_t Size() const { return size_; }
+
+ private:
+  static const int kPageShift = 6;
+  static const int kPageSize = 1 << kPageShift;
+  static const int64_t kPageMask = kPageSize - 1;
+
+  struct Page {
+    Page() : used(0) {}
+
+    bool Contains(int64_t slot) const { return (used >> slot) & 1; }
+
+    // Bit n is set if slots[n] holds an element.
+    uint64_t used;
+    T slots[kPageSize];
+  };
+
+  Page* FindPage(int64_t page_index) {
+    if (page_index == last_page_index_)
+      return last_page_;
+    auto found = pages_.find(page_index);
+    if (found == pages_.end())
+      return nullptr;
+    last_page_index_ = page_index;
+    last_page_ = found->second.get();
+    return last_page_;
+  }
+
+  base::hash_map<int64_t, std::unique_ptr<Page>> pages_;
+  size_t size_;
+
+  // Most lookups hit the page of the previous one.
+  int64_t last_page_index_;
+  Page* last_page_;
+
+  DISALLOW_COPY_AND_ASSIGN(PagedTable);
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_PAGED_TABLE_H_
@@ -0,0 +1,56 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#include "chromium_media_lib/positioned_file_reader.h"
+
+#include <memory>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/task_scheduler/post_task.h"
+#include "media/base/data_source.h"
+
+namespace media {
+
+PositionedFileReader::PositionedFileReader(base::File file, Client* client)
+    : file_(std::move(file)), client_(client) {}
+
+PositionedFileReader::~PositionedFileReader() {}
+
+void PositionedFileReader::Detach() {
+  base::AutoLock auto_lock(lock_);
+  client_ = nullptr;
+}
+
+int64_t PositionedFileReader::GetLength() {
+  return file_.GetLength();
+}
+
+void PositionedFileReader::Read(int read_id, int64_t position, int size) {
+  base::PostTaskWithTraits(
+      FROM_HERE, {base::MayBlock(), base::TaskPriority::USER_BLOCKING},
+      base::Bind(&PositionedFileReader::ReadOnWorker, this, read_id, position,
+                 size));
+}
+
+void PositionedFileReader::ReadOnWorker(int read_id,
+                                        int64_t position,
+                                        int size) {
+  // Read into a buffer of our own: the caller's buffer may be released as
+  // soon as the read is aborted, while pread() can't be interrupted.
+  std::unique_ptr<uint8_t[]> buffer(new uint8_t[size]);
+  int result =
+      file_.Read(position, reinterpret_cast<char*>(buffer.get()), size);
+  if (result < 0)
+    result = DataSource::kReadError;
+  NotifyClient(read_id, result, buffer.get());
+}
+
+void PositionedFileReader::NotifyClient(int read_id,
+                                        int result,
+                                        const uint8_t* data) {
+  base::AutoLock auto_lock(lock_);
+  if (client_)
+    client_->OnFileRead(read_id, result, data);
+}
+
+}  // namespace media
@@ -0,0 +1,63 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_POSITIONED_FILE_READER_H_
+#define CHROMIUM_MEDIA_LIB_POSITIONED_FILE_READER_H_
+
+#include <stdint.h>
+
+#include "base/files/file.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+
+namespace media {
+
+// Serves reads with pread() on the blocking worker pool instead of mapping
+// the file. Any number of reads can be in flight, each one completes on the
+// worker thread which served it. Reference counted so that reads still in
+// flight keep the file open after the owner went away.
+class PositionedFileReader
+    : public base::RefCountedThreadSafe<PositionedFileReader> {
+ public:
+  class Client {
+   public:
+    // Called on a worker thread with the bytes read, 0 at end of file or
+    // DataSource::kReadError. |data| is only valid during the call.
+    virtual void OnFileRead(int read_id, int result, const uint8_t* data) = 0;
+  };
+
+  PositionedFileReader(base::File file, Client* client);
+
+  // No OnFileRead() is delivered once this returns, so the client may be
+  // destroyed afterwards.
+  void Detach();
+
+  bool IsValid() const { return file_.IsValid(); }
+  int64_t GetLength();
+
+  virtual void Read(int read_id, int64_t position, int size);
+
+ protected:
+  friend class base::RefCountedThreadSafe<PositionedFileReader>;
+  virtual ~PositionedFileReader();
+
+  // Delivers a completion unless the client detached.
+  void NotifyClient(int read_id, int result, const uint8_t* data);
+
+  base::File& file() { return file_; }
+
+ private:
+  void ReadOnWorker(int read_id, int64_t position, int size);
+
+  base::File file_;
+  // Held while |client_| is called, which makes Detach() a barrier against
+  // completions running concurrently.
+  base::Lock lock_;
+  Client* client_;
+
+  DISALLOW_COPY_AND_ASSIGN(PositionedFileReader);
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_POSITIONED_FILE_READER_H_
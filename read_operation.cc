@@ -21,4 +21,35 @@ void ReadOperation::Run(std::unique_ptr<ReadOperation> read_op, int result) {
   base::ResetAndReturn(&read_op->callback_).Run(result);
 }
 
+ReadOperationQueue::ReadOperationQueue() : next_id_(0) {}
+
+ReadOperationQueue::~ReadOperationQueue() {}
+
+int ReadOperationQueue::Add(std::unique_ptr<ReadOperation> read_op) {
+  int id = ++next_id_;
+  read_ops_[id] = std::move(read_op);
+  return id;
+}
+
+ReadOperation* ReadOperationQueue::Get(int id) {
+  auto it = read_ops_.find(id);
+  return it == read_ops_.end() ? nullptr : it->second.get();
+}
+
+std::unique_ptr<ReadOperation> ReadOperationQueue::Take(int id) {
+  auto it = read_ops_.find(id);
+  if (it == read_ops_.end())
+    return nullptr;
+  std::unique_ptr<ReadOperation> read_op = std::move(it->second);
+  read_ops_.erase(it);
+  return read_op;
+}
+
+void ReadOperationQueue::RunAll(int result) {
+  Map read_ops;
+  read_ops.swap(read_ops_);
+  for (auto& it : read_ops)
+    ReadOperation::Run(std::move(it.second), result);
+}
+
 }  // namespace media
@@ -5,6 +5,7 @@
 
 #include "media/base/data_source.h"
 
+#include <map>
 #include <memory>
 
 namespace media {
@@ -34,6 +35,38 @@ class ReadOperation {
   DISALLOW_IMPLICIT_CONSTRUCTORS(ReadOperation);
 };
 
+// Read operations which are in flight at the same time. Each one is keyed by
+// the id returned from Add() and may be completed in any order. Ids increase
+// monotonically, so iteration visits the oldest operation first.
+// Not thread safe, owners guard it with their own lock.
+class ReadOperationQueue {
+ public:
+  typedef std::map<int, std::unique_ptr<ReadOperation>> Map;
+
+  ReadOperationQueue();
+  ~ReadOperationQueue();
+
+  int Add(std::unique_ptr<ReadOperation> read_op);
+  // Returns nullptr if |id| was already completed.
+  ReadOperation* Get(int id);
+  // Returns nullptr if |id| was already completed.
+  std::unique_ptr<ReadOperation> Take(int id);
+  // Completes every pending operation with |result|.
+  void RunAll(int result);
+
+  bool empty() const { return read_ops_.empty(); }
+  size_t size() const { return read_ops_.size(); }
+  Map::iterator begin() { return read_ops_.begin(); }
+  Map::iterator end() { return read_ops_.end(); }
+  Map::iterator erase(Map::iterator it) { return read_ops_.erase(it); }
+
+ private:
+  Map read_ops_;
+  int next_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReadOperationQueue);
+};
+
 }  // namespace media
 
 #endif  // CHROMIUM_MEDIA_LIB_READ_OPERATION_H_
@@ -0,0 +1,530 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#include "chromium_media_lib/resource_block_cache.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/memory/ptr_util.h"
+
+namespace media {
+
+namespace {
+
+// Memory shared by the blocks of every network resource in the process.
+const int64_t kMaxCacheBytes = 128 * 1024 * 1024;
+// Disk space shared by the evicted blocks of every network resource.
+const int64_t kMaxDiskCacheBytes = 1024 * 1024 * 1024;
+// Blocks loaded from disk at once, readers rarely need just one.
+const int kDiskReadAheadBlocks = 8;
+// Evicted blocks kept for reuse, enough to absorb the blocks of a player
+// which stopped without holding on to a large share of the budget.
+const int64_t kMaxPooledBytes = kMaxCacheBytes / 4;
+
+struct CacheRegistry {
+  CacheRegistry() : disk_budget(kMaxDiskCacheBytes) {}
+
+  base::Lock lock;
+  std::map<std::string, ResourceBlockCache*> caches;
+  // One per block size, kept for the life of the process.
+  std::map<int32_t, std::unique_ptr<ResourceBlockPool>> pools;
+  ResourceDiskBudget disk_budget;
+};
+
+base::LazyInstance<CacheRegistry>::Leaky g_registry =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+// Holds |lock| like base::AutoLock and adds the time it was held to
+// |stats|, which are guarded by |lock| as well.
+class ResourceBlockCache::TimedAutoLock {
+ public:
+  TimedAutoLock(base::Lock& lock, LockStats* stats)
+      : auto_lock_(lock), stats_(stats), start_(base::TimeTicks::Now()) {}
+
+  ~TimedAutoLock() { stats_->Add(base::TimeTicks::Now() - start_); }
+
+ private:
+  base::AutoLock auto_lock_;
+  LockStats* stats_;
+  const base::TimeTicks start_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimedAutoLock);
+};
+
+ResourceBlockCache::ClientState::ClientState()
+    : playhead(-1), pinned_first(0), pinned_last(-1), write_position(-1) {}
+
+ResourceBlockCache::LockStats::LockStats() : count(0) {}
+
+void ResourceBlockCache::LockStats::Add(base::TimeDelta held) {
+  ++count;
+  total += held;
+  max = std::max(max, held);
+}
+
+// static
+ResourceBlockCache* ResourceBlockCache::Acquire(
+    const GURL& url,
+    int32_t block_size_shift,
+    ResourceEvictionPolicy::Type eviction_policy,
+    Client* client) {
+  CacheRegistry* registry = g_registry.Pointer();
+  // Players with another block size can't share blocks.
+  std::string key =
+      std::to_string(block_size_shift) + ":" + url.GetWithoutRef().spec();
+  base::AutoLock registry_lock(registry->lock);
+  ResourceBlockCache*& cache = registry->caches[key];
+  if (!cache) {
+    std::unique_ptr<ResourceBlockPool>& pool =
+        registry->pools[block_size_shift];
+    if (!pool) {
+      pool = base::MakeUnique<ResourceBlockPool>(1 << block_size_shift,
+                                                 kMaxPooledBytes);
+    }
+    cache = new ResourceBlockCache(key, block_size_shift, eviction_policy,
+                                   pool.get(), &registry->disk_budget);
+  }
+  DLOG_IF(WARNING, cache->policy_->type() != eviction_policy)
+      << "Eviction policy " << ResourceEvictionPolicy::GetName(eviction_policy)
+      << " ignored, the cache of " << url.spec() << " uses "
+      << ResourceEvictionPolicy::GetName(cache->policy_->type());
+  base::AutoLock auto_lock(cache->lock_);
+  DCHECK(!cache->clients_.count(client));
+  cache->clients_[client] = ClientState();
+  return cache;
+}
+
+void ResourceBlockCache::Release(Client* client) {
+  CacheRegistry* registry = g_registry.Pointer();
+  base::AutoLock registry_lock(registry->lock);
+  {
+    base::AutoLock auto_lock(lock_);
+    auto it = clients_.find(client);
+    DCHECK(it != clients_.end());
+    bool was_writing = it->second.write_position >= 0;
+    clients_.erase(it);
+    if (!clients_.empty()) {
+      if (was_writing) {
+        for (auto& other : clients_)
+          other.first->OnWriterRemoved();
+      }
+      return;
+    }
+  }
+  registry->caches.erase(key_);
+  ResourceBlockPool* pool = pool_;
+  delete this;
+  ResourceBlockPool::Stats stats = pool->GetStats();
+  LOG(INFO) << "ResourceBlockPool allocated=" << stats.allocated
+            << " reused=" << stats.reused << " recycled=" << stats.recycled
+            << " discarded=" << stats.discarded
+            << " free=" << stats.free_blocks;
+}
+
+ResourceBlockCache::ResourceBlockCache(
+    const std::string& key,
+    int32_t block_size_shift,
+    ResourceEvictionPolicy::Type eviction_policy,
+    ResourceBlockPool* pool,
+    ResourceDiskBudget* disk_budget)
+    : key_(key),
+      block_size_shift_(block_size_shift),
+      pool_(pool),
+      total_bytes_(-1),
+      policy_(ResourceEvictionPolicy::Create(eviction_policy)),
+      read_hits_(0),
+      read_misses_(0),
+      disk_reloads_(0),
+      disk_cache_(new ResourceDiskCache(block_size_shift, disk_budget,
+                                        pool)) {}
+
+ResourceBlockCache::~ResourceBlockCache() {
+  DCHECK(filling_.empty());
+  LogLockStats("Write", write_lock_stats_);
+  LogLockStats("Fill", fill_lock_stats_);
+  int64_t reads = read_hits_ + read_misses_;
+  LOG(INFO) << "ResourceBlockCache policy="
+            << ResourceEvictionPolicy::GetName(policy_->type())
+            << " hits=" << read_hits_ << " misses=" << read_misses_
+            << " hit_ratio=" << (reads ? read_hits_ * 100 / reads : 0)
+            << "% disk_reloads=" << disk_reloads_;
+  blocks_.ForEach([this](scoped_refptr<DataBuffer>& block) {
+    pool_->Recycle(std::move(block));
+  });
+  disk_cache_->Close();
+}
+
+// static
+void ResourceBlockCache::LogLockStats(const char* name,
+                                      const LockStats& stats) {
+  if (!stats.count)
+    return;
+  LOG(INFO) << "ResourceBlockCache::" << name << " held the lock "
+            << stats.count << " times, avg="
+            << (stats.total / stats.count).InMicroseconds()
+            << "us max=" << stats.max.InMicroseconds() << "us";
+}
+
+MultiBufferBlockId ResourceBlockCache::ToBlockId(int64_t position) const {
+  return position >> block_size_shift_;
+}
+
+int64_t ResourceBlockCache::ToPosition(MultiBufferBlockId id) const {
+  return id << block_size_shift_;
+}
+
+int64_t ResourceBlockCache::GetTotalBytes() {
+  base::AutoLock auto_lock(lock_);
+  return total_bytes_;
+}
+
+void ResourceBlockCache::SetTotalBytes(int64_t total_bytes) {
+  base::AutoLock auto_lock(lock_);
+  total_bytes_ = total_bytes;
+}
+
+int ResourceBlockCache::Fill(int64_t position, int size, uint8_t* data) {
+  struct Copy {
+    scoped_refptr<DataBuffer> block;
+    int start;
+    int size;
+  };
+  std::vector<Copy> copies;
+  {
+    TimedAutoLock auto_lock(lock_, &fill_lock_stats_);
+    const int block_size = 1 << block_size_shift_;
+    MultiBufferBlockId id = ToBlockId(position);
+    scoped_refptr<DataBuffer>* block = blocks_.Find(id);
+    while (block && size > 0 &&
+           ToPosition(id) + (*block)->data_size() >= position) {
+      const int start_position = static_cast<int>(position - ToPosition(id));
+      const int remain_size =
+          std::min((*block)->data_size() - start_position, size);
+      DCHECK_GE(remain_size, 0);
+      // The published prefix doesn't change, the reference keeps it alive
+      // if the block is evicted meanwhile.
+      copies.push_back({*block, start_position, remain_size});
+      size -= remain_size;
+      position += remain_size;
+      policy_->OnRead(id);
+      // the block is not full, so need to wait until ready.
+      if ((*block)->data_size() != block_size)
+        break;
+      block = blocks_.Find(++id);
+    }
+    // Misses include reads waiting for the network, compare policies by
+    // the disk reloads as well.
+    if (copies.empty())
+      ++read_misses_;
+    else
+      ++read_hits_;
+  }
+  int write_bytes = 0;
+  for (const Copy& copy : copies) {
+    memcpy(data + write_bytes, copy.block->data() + copy.start, copy.size);
+    write_bytes += copy.size;
+  }
+  return write_bytes;
+}
+
+int64_t ResourceBlockCache::GetAvailableEnd(int64_t position) {
+  base::AutoLock auto_lock(lock_);
+  const int block_size = 1 << block_size_shift_;
+  MultiBufferBlockId id = ToBlockId(position);
+  int64_t end = position;
+  for (scoped_refptr<DataBuffer>* block = blocks_.Find(id); block;
+       block = blocks_.Find(++id)) {
+    int64_t block_end = ToPosition(id) + (*block)->data_size();
+    if (block_end <= end)
+      break;
+    end = block_end;
+    if ((*block)->data_size() != block_size)
+      break;
+  }
+  return end;
+}
+
+bool ResourceBlockCache::LoadFromDisk(int64_t position) {
+  MultiBufferBlockId id = ToBlockId(position);
+  ResourceDiskCache::LoadCB load_cb =
+      base::Bind(&ResourceBlockCache::OnBlockLoaded, key_);
+  ResourceDiskCache::LoadStatus status = disk_cache_->Load(id, load_cb);
+  if (status == ResourceDiskCache::kNotOnDisk)
+    return false;
+  if (status == ResourceDiskCache::kAlreadyLoading)
+    return true;
+  {
+    base::AutoLock auto_lock(lock_);
+    ++disk_reloads_;
+  }
+  for (int i = 1; i < kDiskReadAheadBlocks; ++i) {
+    {
+      base::AutoLock auto_lock(lock_);
+      if (blocks_.Contains(id + i))
+        break;
+    }
+    if (disk_cache_->Load(id + i, load_cb) == ResourceDiskCache::kNotOnDisk)
+      break;
+  }
+  return true;
+}
+
+void ResourceBlockCache::Write(Client* writer,
+                               int64_t position,
+                               const uint8_t* data,
+                               int size) {
+  struct Copy {
+    MultiBufferBlockId id;
+    scoped_refptr<DataBuffer> block;
+    int start;
+    int end;
+    const uint8_t* data;
+  };
+  std::vector<Copy> copies;
+  bool grew = false;
+  int64_t written_start = -1;
+  int64_t written_end = -1;
+  {
+    TimedAutoLock auto_lock(lock_, &write_lock_stats_);
+    const int block_size = 1 << block_size_shift_;
+    while (size > 0) {
+      MultiBufferBlockId id = ToBlockId(position);
+      const int offset = static_cast<int>(position & (block_size - 1));
+      const int remain_size = std::min(block_size - offset, size);
+      scoped_refptr<DataBuffer>* found = blocks_.Find(id);
+      scoped_refptr<DataBuffer> block;
+      if (found) {
+        block = *found;
+        policy_->OnWritten(id);
+      } else if (offset == 0) {
+        block = pool_->Allocate();
+        blocks_.Insert(id, block);
+        policy_->Insert(id);
+        grew = true;
+      }
+      // Only extend the valid prefix of a block, readers can't tell a hole.
+      // Another writer filling the block meanwhile has claimed the bytes up
+      // to its end, only those after it are copied.
+      const int end = offset + remain_size;
+      if (block) {
+        auto filling = filling_.find(id);
+        const int claimed =
+            filling != filling_.end() ? filling->second.end
+                                      : block->data_size();
+        if (offset <= claimed) {
+          if (end > claimed) {
+            if (filling == filling_.end())
+              filling = filling_.insert({id, Filling{claimed, 0}}).first;
+            filling->second.end = end;
+            ++filling->second.copies;
+            copies.push_back(
+                {id, std::move(block), claimed, end, data + claimed - offset});
+          }
+          if (written_start < 0)
+            written_start = position;
+          written_end = position + remain_size;
+        }
+      }
+      data += remain_size;
+      position += remain_size;
+      size -= remain_size;
+    }
+  }
+  for (const Copy& copy : copies) {
+    memcpy(copy.block->writable_data() + copy.start, copy.data,
+           copy.end - copy.start);
+  }
+  {
+    TimedAutoLock auto_lock(lock_, &write_lock_stats_);
+    for (const Copy& copy : copies) {
+      DCHECK(*blocks_.Find(copy.id) == copy.block);
+      auto filling = filling_.find(copy.id);
+      DCHECK(filling != filling_.end());
+      if (--filling->second.copies)
+        continue;
+      // Includes the bytes of writers which finished earlier, readers
+      // waiting for them weren't woken up yet.
+      copy.block->set_data_size(filling->second.end);
+      written_end = std::max(written_end,
+                             ToPosition(copy.id) + filling->second.end);
+      filling_.erase(filling);
+    }
+    auto it = clients_.find(writer);
+    DCHECK(it != clients_.end());
+    it->second.write_position = position;
+    if (written_start >= 0) {
+      for (auto& client : clients_)
+        client.first->OnBlocksWritten(written_start, written_end);
+    }
+  }
+  if (grew)
+    TrimToBudget();
+}
+
+void ResourceBlockCache::SetPinnedRange(Client* client,
+                                        MultiBufferBlockId playhead,
+                                        MultiBufferBlockId first,
+                                        MultiBufferBlockId last) {
+  base::AutoLock auto_lock(lock_);
+  auto it = clients_.find(client);
+  DCHECK(it != clients_.end());
+  it->second.playhead = playhead;
+  it->second.pinned_first = first;
+  it->second.pinned_last = last;
+}
+
+void ResourceBlockCache::SetWriterPosition(Client* client, int64_t position) {
+  base::AutoLock auto_lock(lock_);
+  auto it = clients_.find(client);
+  DCHECK(it != clients_.end());
+  bool stopped = it->second.write_position >= 0 && position < 0;
+  it->second.write_position = position;
+  if (!stopped)
+    return;
+  for (auto& other : clients_) {
+    if (other.first != client)
+      other.first->OnWriterRemoved();
+  }
+}
+
+bool ResourceBlockCache::HasOtherWriterIn(Client* client,
+                                          int64_t first,
+                                          int64_t last) {
+  base::AutoLock auto_lock(lock_);
+  for (const auto& other : clients_) {
+    int64_t position = other.second.write_position;
+    if (other.first != client && position >= 0 && position >= first &&
+        position <= last) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// static
+void ResourceBlockCache::TrimToBudget() {
+  base::AutoLock registry_lock(g_registry.Pointer()->lock);
+  TrimToBudgetLocked();
+}
+
+// static
+void ResourceBlockCache::TrimToBudgetLocked() {
+  CacheRegistry* registry = g_registry.Pointer();
+  registry->lock.AssertAcquired();
+  std::set<ResourceBlockCache*> exhausted;
+  while (true) {
+    int64_t cached_bytes = 0;
+    int64_t largest_bytes = 0;
+    ResourceBlockCache* largest = nullptr;
+    for (const auto& entry : registry->caches) {
+      int64_t bytes = entry.second->GetCachedBytes();
+      cached_bytes += bytes;
+      if (bytes > largest_bytes && !exhausted.count(entry.second)) {
+        largest_bytes = bytes;
+        largest = entry.second;
+      }
+    }
+    if (cached_bytes <= kMaxCacheBytes || !largest)
+      return;
+    MultiBufferBlockId id;
+    scoped_refptr<DataBuffer> block;
+    if (largest->EvictOne(&id, &block))
+      largest->disk_cache_->Store(id, std::move(block));
+    else
+      exhausted.insert(largest);
+  }
+}
+
+// static
+void ResourceBlockCache::OnBlockLoaded(const std::string& key,
+                                       MultiBufferBlockId id,
+                                       scoped_refptr<DataBuffer> block) {
+  CacheRegistry* registry = g_registry.Pointer();
+  base::AutoLock registry_lock(registry->lock);
+  // The players may have gone meanwhile.
+  auto found = registry->caches.find(key);
+  if (found == registry->caches.end())
+    return;
+  found->second->InsertLoadedBlock(id, std::move(block));
+  TrimToBudgetLocked();
+}
+
+int64_t ResourceBlockCache::GetCachedBytes() {
+  base::AutoLock auto_lock(lock_);
+  return static_cast<int64_t>(blocks_.Size()) << block_size_shift_;
+}
+
+bool ResourceBlockCache::EvictOne(MultiBufferBlockId* id,
+                                  scoped_refptr<DataBuffer>* block) {
+  base::AutoLock auto_lock(lock_);
+  std::vector<int64_t> playheads;
+  for (const auto& client : clients_) {
+    if (client.second.playhead >= 0)
+      playheads.push_back(client.second.playhead);
+  }
+  if (!policy_->Evict(playheads,
+                      base::Bind(&ResourceBlockCache::CanEvict,
+                                 base::Unretained(this)),
+                      id)) {
+    return false;
+  }
+  LOG(INFO) << " erase id=" << *id;
+  *block = blocks_.Take(*id);
+  return true;
+}
+
+void ResourceBlockCache::InsertLoadedBlock(MultiBufferBlockId id,
+                                           scoped_refptr<DataBuffer> block) {
+  base::AutoLock auto_lock(lock_);
+  if (!block) {
+    for (auto& client : clients_)
+      client.first->OnWriterRemoved();
+    return;
+  }
+  const int64_t end = ToPosition(id) + block->data_size();
+  scoped_refptr<DataBuffer>* found = blocks_.Find(id);
+  if (found) {
+    // Fetched again meanwhile, keep whichever holds more, or the one a
+    // writer is filling.
+    if ((*found)->data_size() >= block->data_size() || filling_.count(id)) {
+      pool_->Recycle(std::move(block));
+      return;
+    }
+    std::swap(*found, block);
+    pool_->Recycle(std::move(block));
+    policy_->OnWritten(id);
+  } else {
+    blocks_.Insert(id, std::move(block));
+    policy_->Insert(id);
+  }
+  for (auto& client : clients_)
+    client.first->OnBlocksWritten(ToPosition(id), end);
+}
+
+bool ResourceBlockCache::CanEvict(MultiBufferBlockId id) const {
+  return !IsPinned(id) && !filling_.count(id);
+}
+
+bool ResourceBlockCache::IsPinned(MultiBufferBlockId id) const {
+  lock_.AssertAcquired();
+  for (const auto& client : clients_) {
+    const ClientState& state = client.second;
+    if (id >= state.pinned_first && id <= state.pinned_last)
+      return true;
+    // The block a fetch is filling in.
+    if (state.write_position >= 0 && ToBlockId(state.write_position) == id)
+      return true;
+  }
+  return false;
+}
+
+}  // namespace media
@@ -0,0 +1,178 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_RESOURCE_BLOCK_CACHE_H_
+#define CHROMIUM_MEDIA_LIB_RESOURCE_BLOCK_CACHE_H_
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "chromium_media_lib/paged_table.h"
+#include "chromium_media_lib/resource_block_pool.h"
+#include "chromium_media_lib/resource_disk_cache.h"
+#include "chromium_media_lib/resource_eviction_policy.h"
+#include "media/base/data_buffer.h"
+#include "url/gurl.h"
+
+namespace media {
+
+// Blocks of one network resource, shared by every ResourceMultiBuffer in the
+// process which plays the same URL, so that a stream shown by several
+// players is downloaded and stored once. All caches evict against a single
+// process-wide memory budget, evicted blocks are spilled to a
+// ResourceDiskCache whose files share a process-wide disk budget. Blocks
+// of every cache come from a shared ResourceBlockPool and go back to it
+// once they are dropped.
+//
+// Bytes are copied in and out of the blocks without the cache lock. A
+// writer claims the end of a block, copies into it and then publishes the
+// new size of the block, readers only copy the published prefix, which
+// never changes while the block is cached.
+class ResourceBlockCache {
+ public:
+  class Client {
+   public:
+    // Bytes |start| to |end| of the resource were written. Called with the
+    // cache lock held, must not call back into the cache.
+    virtual void OnBlocksWritten(int64_t start, int64_t end) = 0;
+    // The fetch of another client stopped or a block couldn't be loaded from
+    // disk, data a reader waits for may not arrive. Same restrictions as
+    // OnBlocksWritten().
+    virtual void OnWriterRemoved() = 0;
+
+   protected:
+    virtual ~Client() {}
+  };
+
+  // Returns the cache of |url| with |client| registered. The cache is
+  // created on first use, evicting with |eviction_policy|, and destroyed
+  // once its last client is released. Clients joining later share the
+  // policy of the first one.
+  static ResourceBlockCache* Acquire(
+      const GURL& url,
+      int32_t block_size_shift,
+      ResourceEvictionPolicy::Type eviction_policy,
+      Client* client);
+  void Release(Client* client);
+
+  MultiBufferBlockId ToBlockId(int64_t position) const;
+  int64_t ToPosition(MultiBufferBlockId id) const;
+
+  // -1 until a response told the size of the resource.
+  int64_t GetTotalBytes();
+  void SetTotalBytes(int64_t total_bytes);
+
+  // Copies up to |size| cached bytes at |position| into |data| and returns
+  // the number of bytes copied, 0 if |position| isn't cached.
+  int Fill(int64_t position, int size, uint8_t* data);
+  // Returns the end of the contiguous cached data starting at |position|,
+  // or |position| itself if it isn't cached.
+  int64_t GetAvailableEnd(int64_t position);
+  // Starts loading the blocks from |position| on which were spilled to disk.
+  // Clients are notified through OnBlocksWritten() once they are back in
+  // memory. Returns false if the block at |position| isn't on disk.
+  bool LoadFromDisk(int64_t position);
+  // Stores |size| bytes fetched by |writer| at |position|. Bytes already
+  // cached are not copied again, bytes which would leave a hole in a block
+  // are dropped.
+  void Write(Client* writer, int64_t position, const uint8_t* data, int size);
+
+  // Blocks of |client| in |first|-|last| are not evicted. |playhead| is the
+  // block its reader is at.
+  void SetPinnedRange(Client* client,
+                      MultiBufferBlockId playhead,
+                      MultiBufferBlockId first,
+                      MultiBufferBlockId last);
+  // Position the fetch of |client| writes at next, -1 once it stopped.
+  void SetWriterPosition(Client* client, int64_t position);
+  // True if the fetch of a client other than |client| is at a position in
+  // |first|-|last|.
+  bool HasOtherWriterIn(Client* client, int64_t first, int64_t last);
+
+ private:
+  struct ClientState {
+    ClientState();
+
+    MultiBufferBlockId playhead;
+    MultiBufferBlockId pinned_first;
+    MultiBufferBlockId pinned_last;
+    int64_t write_position;
+  };
+
+  // How long |lock_| was held by one of the hot paths.
+  struct LockStats {
+    LockStats();
+    void Add(base::TimeDelta held);
+
+    int64_t count;
+    base::TimeDelta total;
+    base::TimeDelta max;
+  };
+  class TimedAutoLock;
+
+  ResourceBlockCache(const std::string& key,
+                     int32_t block_size_shift,
+                     ResourceEvictionPolicy::Type eviction_policy,
+                     ResourceBlockPool* pool,
+                     ResourceDiskBudget* disk_budget);
+  ~ResourceBlockCache();
+
+  // Evicts blocks of the caches with the most data until all of them fit
+  // in the budget. Must be called without any cache lock held.
+  static void TrimToBudget();
+  // Same as above with the registry lock held.
+  static void TrimToBudgetLocked();
+  // Puts a block loaded by |disk_cache_| of the cache with |key| back.
+  static void OnBlockLoaded(const std::string& key,
+                            MultiBufferBlockId id,
+                            scoped_refptr<DataBuffer> block);
+  static void LogLockStats(const char* name, const LockStats& stats);
+
+  int64_t GetCachedBytes();
+  // Moves the block the eviction policy picks among those no client needs
+  // into |id| and |block|. Returns false if every block is pinned or being
+  // filled.
+  bool EvictOne(MultiBufferBlockId* id, scoped_refptr<DataBuffer>* block);
+  // |block| is null if it couldn't be loaded.
+  void InsertLoadedBlock(MultiBufferBlockId id,
+                         scoped_refptr<DataBuffer> block);
+  // |lock_| must be held.
+  bool CanEvict(MultiBufferBlockId id) const;
+  bool IsPinned(MultiBufferBlockId id) const;
+
+  const std::string key_;
+  const int32_t block_size_shift_;
+  ResourceBlockPool* const pool_;
+
+  base::Lock lock_;
+  int64_t total_bytes_;
+  PagedTable<scoped_refptr<DataBuffer>> blocks_;
+  std::unique_ptr<ResourceEvictionPolicy> policy_;
+  std::map<Client*, ClientState> clients_;
+  // Blocks writers are copying into, they are neither evicted nor replaced.
+  // Writers copy disjoint ranges one after the other, the last one to
+  // finish publishes the bytes up to |end|.
+  struct Filling {
+    int end;
+    int copies;
+  };
+  std::map<MultiBufferBlockId, Filling> filling_;
+  LockStats write_lock_stats_;
+  LockStats fill_lock_stats_;
+  int64_t read_hits_;
+  int64_t read_misses_;
+  // Reads which had to go back to the disk cache.
+  int64_t disk_reloads_;
+
+  const scoped_refptr<ResourceDiskCache> disk_cache_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResourceBlockCache);
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_RESOURCE_BLOCK_CACHE_H_
@@ -0,0 +1,60 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#include "chromium_media_lib/resource_block_pool.h"
+
+#include <utility>
+
+#include "base/logging.h"
+
+namespace media {
+
+ResourceBlockPool::Stats::Stats()
+    : allocated(0), reused(0), recycled(0), discarded(0), free_blocks(0) {}
+
+ResourceBlockPool::ResourceBlockPool(int block_size, int64_t max_free_bytes)
+    : block_size_(block_size),
+      max_free_blocks_(static_cast<size_t>(max_free_bytes / block_size)) {}
+
+ResourceBlockPool::~ResourceBlockPool() {}
+
+scoped_refptr<DataBuffer> ResourceBlockPool::Allocate() {
+  {
+    base::AutoLock auto_lock(lock_);
+    if (!free_blocks_.empty()) {
+      scoped_refptr<DataBuffer> block = std::move(free_blocks_.back());
+      free_blocks_.pop_back();
+      ++stats_.reused;
+      return block;
+    }
+    ++stats_.allocated;
+  }
+  // Outside the lock, the allocator has its own.
+  return new DataBuffer(block_size_);
+}
+
+void ResourceBlockPool::Recycle(scoped_refptr<DataBuffer> block) {
+  if (!block)
+    return;
+  bool reusable = block->HasOneRef();
+  if (reusable)
+    block->set_data_size(0);
+  {
+    base::AutoLock auto_lock(lock_);
+    if (reusable && free_blocks_.size() < max_free_blocks_) {
+      ++stats_.recycled;
+      free_blocks_.push_back(std::move(block));
+      return;
+    }
+    ++stats_.discarded;
+  }
+  // |block| is released outside the lock.
+}
+
+ResourceBlockPool::Stats ResourceBlockPool::GetStats() {
+  base::AutoLock auto_lock(lock_);
+  Stats stats = stats_;
+  stats.free_blocks = free_blocks_.size();
+  return stats;
+}
+
+}  // namespace media
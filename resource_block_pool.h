@@ -0,0 +1,59 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_RESOURCE_BLOCK_POOL_H_
+#define CHROMIUM_MEDIA_LIB_RESOURCE_BLOCK_POOL_H_
+
+#include <vector>
+
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "media/base/data_buffer.h"
+
+namespace media {
+
+// Recycles the fixed size DataBuffers of the ResourceBlockCaches, so that a
+// steady download doesn't allocate and free a block for every block size
+// bytes written. Blocks are allocated on demand and, once evicted, kept for
+// reuse up to |max_free_bytes|, after a while the pool is a slab of the
+// cache budget.
+class ResourceBlockPool {
+ public:
+  struct Stats {
+    Stats();
+
+    // Blocks newly allocated, handed out again and taken back.
+    int64_t allocated;
+    int64_t reused;
+    int64_t recycled;
+    // Blocks freed because the pool was full or they were still in use.
+    int64_t discarded;
+    size_t free_blocks;
+  };
+
+  ResourceBlockPool(int block_size, int64_t max_free_bytes);
+  ~ResourceBlockPool();
+
+  int block_size() const { return block_size_; }
+
+  // Returns an empty block of block_size() bytes.
+  scoped_refptr<DataBuffer> Allocate();
+  // Takes |block| back for reuse unless someone else still refers to it.
+  void Recycle(scoped_refptr<DataBuffer> block);
+
+  Stats GetStats();
+
+ private:
+  const int block_size_;
+  const size_t max_free_blocks_;
+
+  base::Lock lock_;
+  std::vector<scoped_refptr<DataBuffer>> free_blocks_;
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResourceBlockPool);
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_RESOURCE_BLOCK_POOL_H_
@@ -1,6 +1,7 @@
 #include "chromium_media_lib/resource_data_source.h"
 
 #include "base/callback_helpers.h"
+#include "base/memory/ptr_util.h"
 #include "net/base/net_errors.h"
 
 namespace media {
@@ -10,18 +11,22 @@ const int kBlockSizeShift = 15;  // 1<<15 == 32kb
 ResourceDataSource::ResourceDataSource(
     const GURL& url,
     const scoped_refptr<base::SingleThreadTaskRunner>& task_runner,
-    const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner)
+    const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner,
+    const ResourceMultiBuffer::Options& options)
     : render_task_runner_(task_runner),
       io_task_runner_(io_task_runner),
       url_(url),
       stop_signal_received_(false),
       total_bytes_(0),
-      multibuffer_(this, url, kBlockSizeShift, io_task_runner_),
+      multibuffer_(this, url, kBlockSizeShift, io_task_runner_, options),
+      read_task_pending_(0),
       weak_factory_(this) {
   weak_ptr_ = weak_factory_.GetWeakPtr();
 }
 
-ResourceDataSource::~ResourceDataSource() {}
+ResourceDataSource::~ResourceDataSource() {
+  multibuffer_.Detach();
+}
 
 void ResourceDataSource::Initialize(const InitializeCB& init_cb) {
   DCHECK(render_task_runner_->BelongsToCurrentThread());
@@ -33,11 +38,13 @@ void ResourceDataSource::Initialize(const InitializeCB& init_cb) {
 void ResourceDataSource::Stop() {
   base::AutoLock auto_lock(lock_);
   stop_signal_received_ = true;
+  read_ops_.RunAll(kReadError);
 }
 
 void ResourceDataSource::Abort() {
+  // Only the pending reads are aborted, future reads are still served.
   base::AutoLock auto_lock(lock_);
-  stop_signal_received_ = true;
+  read_ops_.RunAll(kAborted);
 }
 
 void ResourceDataSource::Read(int64_t position,
@@ -45,20 +52,18 @@ void ResourceDataSource::Read(int64_t position,
                               uint8_t* data,
                               const DataSource::ReadCB& read_cb) {
   DCHECK(!read_cb.is_null());
-  DCHECK(!read_op_);
   {
     base::AutoLock auto_lock(lock_);
     if (stop_signal_received_) {
       read_cb.Run(kReadError);
       return;
     }
+    read_ops_.Add(
+        base::MakeUnique<ReadOperation>(position, size, data, read_cb));
+    ScheduleReadTask();
   }
-  read_op_.reset(new ReadOperation(position, size, data, read_cb));
-  LOG(INFO) << "ResourceDataSource::Read position=" << read_op_->position()
-            << " size=" << read_op_->size();
-  render_task_runner_->PostTask(
-      FROM_HERE,
-      base::Bind(&ResourceDataSource::ReadTask, weak_factory_.GetWeakPtr()));
+  LOG(INFO) << "ResourceDataSource::Read position=" << position
+            << " size=" << size;
 }
 
 bool ResourceDataSource::GetSize(int64_t* size_out) {
@@ -74,36 +79,57 @@ bool ResourceDataSource::GetSize(int64_t* size_out) {
 }
 
 bool ResourceDataSource::IsStreaming() {
-  return false;
+  return multibuffer_.IsStreaming();
 }
 
 void ResourceDataSource::SetBitrate(int bitrate) {
-  // Do nothing
+  multibuffer_.SetBitrate(bitrate);
+}
+
+void ResourceDataSource::ScheduleReadTask() {
+  if (base::subtle::NoBarrier_CompareAndSwap(&read_task_pending_, 0, 1))
+    return;
+  render_task_runner_->PostTask(
+      FROM_HERE, base::Bind(&ResourceDataSource::ReadTask, weak_ptr_));
 }
 
 void ResourceDataSource::ReadTask() {
   DCHECK(render_task_runner_->BelongsToCurrentThread());
+  base::subtle::Release_Store(&read_task_pending_, 0);
   base::AutoLock auto_lock(lock_);
-  if (stop_signal_received_ || !read_op_)
+  if (stop_signal_received_ || read_ops_.empty())
     return;
-  DCHECK(read_op_->size());
-  multibuffer_.Seek(read_op_->position());
-  int bytes_read = multibuffer_.Fill(read_op_->position(), read_op_->size(),
-                                     read_op_->data());
-  LOG(INFO) << "ResourceDataSource::ReadTask read_op=" << read_op_.get()
-            << " position=" << read_op_->position()
-            << " id=" << multibuffer_.ToBlockId(read_op_->position())
-            << " size=" << read_op_->size() << " bytes_read=" << bytes_read;
-  if (bytes_read > 0) {
-    ReadOperation::Run(std::move(read_op_), bytes_read);
-  } else if (bytes_read == net::ERR_IO_PENDING) {
-    // wait until OnUpdateState
-    render_task_runner_->PostDelayedTask(
-        FROM_HERE,
-        base::Bind(&ResourceDataSource::ReadTask, weak_factory_.GetWeakPtr()),
-        base::TimeDelta::FromMilliseconds(1000));
-  } else {
-    ReadOperation::Run(std::move(read_op_), kReadError);
+  int64_t total_bytes = multibuffer_.GetSize();
+  // Only the oldest read steers the fetcher. Younger reads complete as soon
+  // as their data is buffered, otherwise they wait for their turn.
+  multibuffer_.Seek(read_ops_.begin()->second->position());
+  for (auto it = read_ops_.begin(); it != read_ops_.end();) {
+    ReadOperation* read_op = it->second.get();
+    DCHECK(read_op->size());
+    int bytes_read = 0;
+    // Nothing will ever arrive beyond the end of the resource.
+    if (total_bytes < 0 || read_op->position() < total_bytes) {
+      bytes_read = multibuffer_.Fill(read_op->position(), read_op->size(),
+                                     read_op->data());
+    }
+    LOG(INFO) << "ResourceDataSource::ReadTask read_op=" << read_op
+              << " position=" << read_op->position()
+              << " id=" << multibuffer_.ToBlockId(read_op->position())
+              << " size=" << read_op->size() << " bytes_read=" << bytes_read;
+    if (bytes_read == net::ERR_IO_PENDING) {
+      ++it;
+      continue;
+    }
+    std::unique_ptr<ReadOperation> done = std::move(it->second);
+    it = read_ops_.erase(it);
+    ReadOperation::Run(std::move(done),
+                       bytes_read >= 0 ? bytes_read : kReadError);
+  }
+  // Sleep until the multibuffer has written what the oldest read needs.
+  if (!read_ops_.empty() &&
+      !multibuffer_.NotifyWhenAvailable(
+          read_ops_.begin()->second->position())) {
+    ScheduleReadTask();
   }
 }
 
@@ -111,16 +137,15 @@ void ResourceDataSource::DidInitialize() {
   if (init_cb_.is_null())
     return;
   DCHECK(io_task_runner_->BelongsToCurrentThread());
-  base::AutoLock auto_lock(lock_);
+  // Called under the lock of |multibuffer_|, must not lock. |init_cb_| is
+  // only used on the IO thread once Initialize() started the fetch.
   render_task_runner_->PostTask(
       FROM_HERE, base::Bind(base::ResetAndReturn(&init_cb_), true));
 }
 
 void ResourceDataSource::OnUpdateState() {
-  DCHECK(io_task_runner_->BelongsToCurrentThread());
-  render_task_runner_->PostTask(
-      FROM_HERE,
-      base::Bind(&ResourceDataSource::ReadTask, weak_factory_.GetWeakPtr()));
+  // Called from cache notifications of any player, must not lock.
+  ScheduleReadTask();
 }
 
 }  // namespace media
@@ -5,6 +5,7 @@
 
 #include <memory>
 
+#include "base/atomicops.h"
 #include "base/bind.h"
 #include "base/callback.h"
 #include "base/macros.h"
@@ -23,7 +24,8 @@ class ResourceDataSource : public DataSource, public ResourceMultiBufferClient {
   ResourceDataSource(
       const GURL& url,
       const scoped_refptr<base::SingleThreadTaskRunner>& task_runner,
-      const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner);
+      const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner,
+      const ResourceMultiBuffer::Options& options);
   ~ResourceDataSource() override;
 
   typedef base::Callback<void(bool)> InitializeCB;
@@ -47,6 +49,9 @@ class ResourceDataSource : public DataSource, public ResourceMultiBufferClient {
   void OnUpdateState() override;
 
  private:
+  // Posts ReadTask() unless one is already pending. Lock-free, may be
+  // called from any thread.
+  void ScheduleReadTask();
   void ReadTask();
 
  private:
@@ -61,7 +66,8 @@ class ResourceDataSource : public DataSource, public ResourceMultiBufferClient {
   InitializeCB init_cb_;
   ResourceMultiBuffer multibuffer_;
 
-  std::unique_ptr<ReadOperation> read_op_;
+  ReadOperationQueue read_ops_;
+  base::subtle::Atomic32 read_task_pending_;
 
   base::WeakPtr<ResourceDataSource> weak_ptr_;
   base::WeakPtrFactory<ResourceDataSource> weak_factory_;
@@ -0,0 +1,211 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#include "chromium_media_lib/resource_disk_cache.h"
+
+#include <utility>
+
+#include "base/bind.h"
+#include "base/files/file_util.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/task_scheduler/post_task.h"
+
+namespace media {
+
+ResourceDiskBudget::ResourceDiskBudget(int64_t max_bytes)
+    : max_bytes_(max_bytes), used_bytes_(0) {}
+
+ResourceDiskBudget::~ResourceDiskBudget() {}
+
+bool ResourceDiskBudget::Reserve(int64_t bytes) {
+  base::AutoLock auto_lock(lock_);
+  if (used_bytes_ + bytes > max_bytes_)
+    return false;
+  used_bytes_ += bytes;
+  return true;
+}
+
+void ResourceDiskBudget::Release(int64_t bytes) {
+  base::AutoLock auto_lock(lock_);
+  DCHECK_GE(used_bytes_, bytes);
+  used_bytes_ -= bytes;
+}
+
+ResourceDiskCache::ResourceDiskCache(int32_t block_size_shift,
+                                     ResourceDiskBudget* budget,
+                                     ResourceBlockPool* pool)
+    : block_size_shift_(block_size_shift),
+      budget_(budget),
+      pool_(pool),
+      task_runner_(base::CreateSequencedTaskRunnerWithTraits(
+          {base::MayBlock(), base::TaskPriority::USER_VISIBLE})),
+      file_failed_(false),
+      next_slot_(0) {}
+
+ResourceDiskCache::~ResourceDiskCache() {
+  DCHECK(!file_.IsValid());
+}
+
+void ResourceDiskCache::Store(MultiBufferBlockId id,
+                              scoped_refptr<DataBuffer> block) {
+  if (!block->data_size()) {
+    pool_->Recycle(std::move(block));
+    return;
+  }
+  base::AutoLock auto_lock(lock_);
+  auto found = index_.find(id);
+  if (found != index_.end()) {
+    lru_.Use(id);
+    if (found->second.size >= block->data_size()) {
+      pool_->Recycle(std::move(block));
+      return;
+    }
+    // The block grew since it was spilled, rewrite its slot.
+    found->second.size = block->data_size();
+    task_runner_->PostTask(
+        FROM_HERE,
+        base::Bind(&ResourceDiskCache::WriteOnSequence, this, id,
+                   found->second.slot, base::Passed(&block)));
+    return;
+  }
+  int slot;
+  if (!free_slots_.empty()) {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  } else if (budget_->Reserve(int64_t{1} << block_size_shift_)) {
+    slot = next_slot_++;
+  } else if (!lru_.Empty()) {
+    MultiBufferBlockId oldest = lru_.Peek();
+    slot = index_[oldest].slot;
+    RemoveEntry(oldest);
+    free_slots_.pop_back();
+  } else {
+    pool_->Recycle(std::move(block));
+    return;
+  }
+  Entry& entry = index_[id];
+  entry.slot = slot;
+  entry.size = block->data_size();
+  entry.loading = false;
+  lru_.Insert(id);
+  // Writes and reads run in order on |task_runner_|, so the slot can be
+  // read back or reused right away.
+  task_runner_->PostTask(
+      FROM_HERE, base::Bind(&ResourceDiskCache::WriteOnSequence, this, id,
+                            slot, base::Passed(&block)));
+}
+
+ResourceDiskCache::LoadStatus ResourceDiskCache::Load(
+    MultiBufferBlockId id,
+    const LoadCB& load_cb) {
+  base::AutoLock auto_lock(lock_);
+  auto found = index_.find(id);
+  if (found == index_.end())
+    return kNotOnDisk;
+  if (found->second.loading)
+    return kAlreadyLoading;
+  found->second.loading = true;
+  lru_.Use(id);
+  task_runner_->PostTask(
+      FROM_HERE,
+      base::Bind(&ResourceDiskCache::ReadOnSequence, this, id,
+                 found->second.slot, found->second.size, load_cb));
+  return kLoadStarted;
+}
+
+void ResourceDiskCache::Close() {
+  task_runner_->PostTask(
+      FROM_HERE, base::Bind(&ResourceDiskCache::CloseOnSequence, this));
+}
+
+bool ResourceDiskCache::EnsureFileOnSequence() {
+  DCHECK(task_runner_->RunsTasksInCurrentSequence());
+  if (file_.IsValid())
+    return true;
+  if (file_failed_)
+    return false;
+  base::FilePath path;
+  if (base::CreateTemporaryFile(&path)) {
+    file_.Initialize(path, base::File::FLAG_OPEN | base::File::FLAG_READ |
+                               base::File::FLAG_WRITE);
+    // Nobody else needs the name, nothing is left behind after a crash.
+    base::DeleteFile(path, false);
+  }
+  if (!file_.IsValid()) {
+    LOG(ERROR) << "Can't create the disk cache file";
+    file_failed_ = true;
+  }
+  return file_.IsValid();
+}
+
+void ResourceDiskCache::WriteOnSequence(MultiBufferBlockId id,
+                                        int slot,
+                                        scoped_refptr<DataBuffer> block) {
+  int64_t offset = static_cast<int64_t>(slot) << block_size_shift_;
+  bool written =
+      EnsureFileOnSequence() &&
+      file_.Write(offset, reinterpret_cast<const char*>(block->data()),
+                  block->data_size()) == block->data_size();
+  pool_->Recycle(std::move(block));
+  if (written)
+    return;
+  base::AutoLock auto_lock(lock_);
+  auto found = index_.find(id);
+  if (found != index_.end() && found->second.slot == slot)
+    RemoveEntry(id);
+}
+
+void ResourceDiskCache::ReadOnSequence(MultiBufferBlockId id,
+                                       int slot,
+                                       int size,
+                                       const LoadCB& load_cb) {
+  bool evicted;
+  {
+    base::AutoLock auto_lock(lock_);
+    auto found = index_.find(id);
+    // Evicted meanwhile, the slot may hold another block by now.
+    evicted = found == index_.end() || found->second.slot != slot;
+    if (!evicted)
+      found->second.loading = false;
+  }
+  if (evicted) {
+    load_cb.Run(id, nullptr);
+    return;
+  }
+  scoped_refptr<DataBuffer> block = pool_->Allocate();
+  int64_t offset = static_cast<int64_t>(slot) << block_size_shift_;
+  if (!EnsureFileOnSequence() ||
+      file_.Read(offset, reinterpret_cast<char*>(block->writable_data()),
+                 size) != size) {
+    {
+      base::AutoLock auto_lock(lock_);
+      auto found = index_.find(id);
+      if (found != index_.end() && found->second.slot == slot)
+        RemoveEntry(id);
+    }
+    pool_->Recycle(std::move(block));
+    load_cb.Run(id, nullptr);
+    return;
+  }
+  block->set_data_size(size);
+  load_cb.Run(id, std::move(block));
+}
+
+void ResourceDiskCache::CloseOnSequence() {
+  file_.Close();
+  // The file was deleted when it was created, its space is free now.
+  base::AutoLock auto_lock(lock_);
+  budget_->Release(static_cast<int64_t>(next_slot_) << block_size_shift_);
+  next_slot_ = 0;
+}
+
+void ResourceDiskCache::RemoveEntry(MultiBufferBlockId id) {
+  lock_.AssertAcquired();
+  auto found = index_.find(id);
+  DCHECK(found != index_.end());
+  free_slots_.push_back(found->second.slot);
+  index_.erase(found);
+  lru_.Remove(id);
+}
+
+}  // namespace media
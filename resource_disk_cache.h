@@ -0,0 +1,123 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_RESOURCE_DISK_CACHE_H_
+#define CHROMIUM_MEDIA_LIB_RESOURCE_DISK_CACHE_H_
+
+#include <map>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/sequenced_task_runner.h"
+#include "base/synchronization/lock.h"
+#include "chromium_media_lib/lru.h"
+#include "chromium_media_lib/resource_block_pool.h"
+#include "media/base/data_buffer.h"
+
+namespace media {
+
+typedef int64_t MultiBufferBlockId;
+
+// Disk space shared by all ResourceDiskCaches of the process. A cache
+// reserves a slot of it before its file grows and releases the whole file
+// once it is closed.
+class ResourceDiskBudget {
+ public:
+  explicit ResourceDiskBudget(int64_t max_bytes);
+  ~ResourceDiskBudget();
+
+  // Returns false if |bytes| more don't fit.
+  bool Reserve(int64_t bytes);
+  void Release(int64_t bytes);
+
+ private:
+  const int64_t max_bytes_;
+
+  base::Lock lock_;
+  int64_t used_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResourceDiskBudget);
+};
+
+// Second tier of a ResourceBlockCache. Blocks evicted from memory are
+// spilled into fixed size slots of a temporary file and loaded back when a
+// reader comes back to them, instead of fetching them again. The file grows
+// while |budget| has room, then the least recently used slots of this file
+// are reused. File I/O runs on a blocking sequence. Blocks are returned to
+// |pool| once written and loaded into blocks taken from it.
+class ResourceDiskCache
+    : public base::RefCountedThreadSafe<ResourceDiskCache> {
+ public:
+  // Runs on the blocking sequence with the loaded block, or null if it
+  // couldn't be read.
+  typedef base::Callback<void(MultiBufferBlockId, scoped_refptr<DataBuffer>)>
+      LoadCB;
+
+  ResourceDiskCache(int32_t block_size_shift,
+                    ResourceDiskBudget* budget,
+                    ResourceBlockPool* pool);
+
+  // Writes |block| to the file unless it is there already, then recycles
+  // it.
+  void Store(MultiBufferBlockId id, scoped_refptr<DataBuffer> block);
+  enum LoadStatus {
+    kNotOnDisk,
+    kLoadStarted,
+    // |load_cb| of the earlier Load() runs, the new one doesn't.
+    kAlreadyLoading,
+  };
+
+  // Starts reading block |id| back.
+  LoadStatus Load(MultiBufferBlockId id, const LoadCB& load_cb);
+  // Closes the file once pending I/O is done.
+  void Close();
+
+ private:
+  friend class base::RefCountedThreadSafe<ResourceDiskCache>;
+
+  struct Entry {
+    int slot;
+    int size;
+    bool loading;
+  };
+
+  ~ResourceDiskCache();
+
+  bool EnsureFileOnSequence();
+  void WriteOnSequence(MultiBufferBlockId id,
+                       int slot,
+                       scoped_refptr<DataBuffer> block);
+  void ReadOnSequence(MultiBufferBlockId id,
+                      int slot,
+                      int size,
+                      const LoadCB& load_cb);
+  void CloseOnSequence();
+  // Forgets block |id| and returns its slot to the free list. |lock_| must
+  // be held.
+  void RemoveEntry(MultiBufferBlockId id);
+
+  const int32_t block_size_shift_;
+  ResourceDiskBudget* const budget_;
+  ResourceBlockPool* const pool_;
+  const scoped_refptr<base::SequencedTaskRunner> task_runner_;
+
+  // Only used on |task_runner_|.
+  base::File file_;
+  bool file_failed_;
+
+  base::Lock lock_;
+  std::map<MultiBufferBlockId, Entry> index_;
+  LRU<MultiBufferBlockId> lru_;
+  std::vector<int> free_slots_;
+  // Slots taken from |budget_| so far, the size of the file.
+  int next_slot_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResourceDiskCache);
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_RESOURCE_DISK_CACHE_H_
@@ -0,0 +1,212 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#include "chromium_media_lib/resource_eviction_policy.h"
+
+#include <algorithm>
+#include <limits>
+#include <set>
+
+#include "base/containers/hash_tables.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "chromium_media_lib/lru.h"
+
+namespace media {
+
+namespace {
+
+// A block behind a reader counts as this many blocks ahead of it. Readers
+// mostly move forward, going back takes a seek.
+const int64_t kBehindWeight = 4;
+
+class LeastRecentlyUsedPolicy : public ResourceEvictionPolicy {
+ public:
+  LeastRecentlyUsedPolicy() {}
+
+  Type type() const override { return kLeastRecentlyUsed; }
+
+  void Insert(int64_t id) override { lru_.Insert(id); }
+  void Remove(int64_t id) override { lru_.Remove(id); }
+  void OnRead(int64_t id) override { lru_.Use(id); }
+  void OnWritten(int64_t id) override { lru_.Use(id); }
+
+  bool Evict(const std::vector<int64_t>& playheads,
+             const CanEvictCB& can_evict,
+             int64_t* id) override {
+    // Blocks which can't go keep their place.
+    if (!lru_.FindOldest(
+            [&can_evict](int64_t block) { return can_evict.Run(block); },
+            id)) {
+      return false;
+    }
+    lru_.Remove(*id);
+    return true;
+  }
+
+ private:
+  LRU<int64_t> lru_;
+
+  DISALLOW_COPY_AND_ASSIGN(LeastRecentlyUsedPolicy);
+};
+
+class PlayheadDistancePolicy : public ResourceEvictionPolicy {
+ public:
+  PlayheadDistancePolicy() {}
+
+  Type type() const override { return kPlayheadDistance; }
+
+  void Insert(int64_t id) override { blocks_.insert(id); }
+  void Remove(int64_t id) override { blocks_.erase(id); }
+  void OnRead(int64_t id) override {}
+  void OnWritten(int64_t id) override {}
+
+  bool Evict(const std::vector<int64_t>& playheads,
+             const CanEvictCB& can_evict,
+             int64_t* id) override {
+    // Linear in the blocks cached, which are a few thousand at most.
+    int64_t best_score = -1;
+    for (int64_t block : blocks_) {
+      int64_t score = GetScore(playheads, block);
+      if (score > best_score && can_evict.Run(block)) {
+        best_score = score;
+        *id = block;
+      }
+    }
+    if (best_score < 0)
+      return false;
+    blocks_.erase(*id);
+    return true;
+  }
+
+ private:
+  // Weighted distance to the nearest reader, 0 without readers, which
+  // evicts from the start of the resource.
+  static int64_t GetScore(const std::vector<int64_t>& playheads,
+                          int64_t id) {
+    if (playheads.empty())
+      return 0;
+    int64_t score = std::numeric_limits<int64_t>::max();
+    for (int64_t playhead : playheads) {
+      int64_t distance =
+          id < playhead ? (playhead - id) * kBehindWeight : id - playhead;
+      score = std::min(score, distance);
+    }
+    return score;
+  }
+
+  std::set<int64_t> blocks_;
+
+  DISALLOW_COPY_AND_ASSIGN(PlayheadDistancePolicy);
+};
+
+class ClockPolicy : public ResourceEvictionPolicy {
+ public:
+  ClockPolicy() : hand_(0) {}
+
+  Type type() const override { return kClock; }
+
+  void Insert(int64_t id) override {
+    DCHECK(!slots_.count(id));
+    size_t slot;
+    if (!free_slots_.empty()) {
+      slot = free_slots_.back();
+      free_slots_.pop_back();
+    } else {
+      slot = ring_.size();
+      ring_.push_back(Entry());
+    }
+    ring_[slot].id = id;
+    ring_[slot].used = true;
+    // New blocks have to be read again before the hand passes to stay.
+    ring_[slot].referenced = false;
+    slots_[id] = slot;
+  }
+
+  void Remove(int64_t id) override {
+    auto found = slots_.find(id);
+    DCHECK(found != slots_.end());
+    ring_[found->second].used = false;
+    free_slots_.push_back(found->second);
+    slots_.erase(found);
+  }
+
+  void OnRead(int64_t id) override {
+    auto found = slots_.find(id);
+    if (found != slots_.end())
+      ring_[found->second].referenced = true;
+  }
+
+  void OnWritten(int64_t id) override {}
+
+  bool Evict(const std::vector<int64_t>& playheads,
+             const CanEvictCB& can_evict,
+             int64_t* id) override {
+    // Two turns clear every reference bit on the way.
+    for (size_t i = 0; i < 2 * ring_.size(); ++i) {
+      if (hand_ >= ring_.size())
+        hand_ = 0;
+      Entry& entry = ring_[hand_++];
+      if (!entry.used)
+        continue;
+      if (entry.referenced) {
+        entry.referenced = false;
+        continue;
+      }
+      if (!can_evict.Run(entry.id))
+        continue;
+      *id = entry.id;
+      Remove(entry.id);
+      return true;
+    }
+    return false;
+  }
+
+ private:
+  struct Entry {
+    int64_t id;
+    bool used;
+    bool referenced;
+  };
+
+  std::vector<Entry> ring_;
+  std::vector<size_t> free_slots_;
+  base::hash_map<int64_t, size_t> slots_;
+  size_t hand_;
+
+  DISALLOW_COPY_AND_ASSIGN(ClockPolicy);
+};
+
+}  // namespace
+
+// static
+std::unique_ptr<ResourceEvictionPolicy> ResourceEvictionPolicy::Create(
+    Type type) {
+  switch (type) {
+    case kLeastRecentlyUsed:
+      return std::unique_ptr<ResourceEvictionPolicy>(
+          new LeastRecentlyUsedPolicy());
+    case kPlayheadDistance:
+      return std::unique_ptr<ResourceEvictionPolicy>(
+          new PlayheadDistancePolicy());
+    case kClock:
+      return std::unique_ptr<ResourceEvictionPolicy>(new ClockPolicy());
+  }
+  NOTREACHED();
+  return nullptr;
+}
+
+// static
+const char* ResourceEvictionPolicy::GetName(Type type) {
+  switch (type) {
+    case kLeastRecentlyUsed:
+      return "lru";
+    case kPlayheadDistance:
+      return "playhead";
+    case kClock:
+      return "clock";
+  }
+  NOTREACHED();
+  return "";
+}
+
+}  // namespace media
@@ -0,0 +1,60 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_RESOURCE_EVICTION_POLICY_H_
+#define CHROMIUM_MEDIA_LIB_RESOURCE_EVICTION_POLICY_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "base/callback.h"
+
+namespace media {
+
+// Decides which block a ResourceBlockCache drops when it is over budget.
+// Blocks are identified by their index in the resource. Used with the cache
+// lock held.
+class ResourceEvictionPolicy {
+ public:
+  enum Type {
+    // The least recently read or written block.
+    kLeastRecentlyUsed,
+    // The block farthest from every reader, blocks behind a reader go
+    // well before blocks ahead of it.
+    kPlayheadDistance,
+    // CLOCK, blocks are only spared once they were read again since they
+    // were written, so a single pass over the resource doesn't flush what
+    // readers come back to.
+    kClock,
+  };
+
+  // Returns true if the block may be evicted.
+  typedef base::Callback<bool(int64_t)> CanEvictCB;
+
+  static std::unique_ptr<ResourceEvictionPolicy> Create(Type type);
+  static const char* GetName(Type type);
+
+  virtual ~ResourceEvictionPolicy() {}
+
+  virtual Type type() const = 0;
+
+  // Block |id| entered the cache.
+  virtual void Insert(int64_t id) = 0;
+  // Block |id| left the cache other than through Evict().
+  virtual void Remove(int64_t id) = 0;
+  // Block |id| was read, or more bytes were written to it.
+  virtual void OnRead(int64_t id) = 0;
+  virtual void OnWritten(int64_t id) = 0;
+
+  // Picks a block which |can_evict| accepts, forgets it and stores it in
+  // |id|. |playheads| are the blocks the readers are at. Returns false if
+  // no block may be evicted.
+  virtual bool Evict(const std::vector<int64_t>& playheads,
+                     const CanEvictCB& can_evict,
+                     int64_t* id) = 0;
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_RESOURCE_EVICTION_POLICY_H_
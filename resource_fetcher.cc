@@ -0,0 +1,240 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#include "chromium_media_lib/resource_fetcher.h"
+
+#include <sstream>
+
+#include "base/lazy_instance.h"
+#include "base/memory/ptr_util.h"
+#include "base/synchronization/lock.h"
+#include "net/base/load_flags.h"
+#include "net/base/net_errors.h"
+#include "net/base/privacy_mode.h"
+#include "net/http/http_network_session.h"
+#include "net/http/http_request_info.h"
+#include "net/http/http_response_headers.h"
+#include "net/http/http_stream_factory.h"
+#include "net/http/http_transaction_factory.h"
+#include "net/proxy/proxy_config_service_fixed.h"
+#include "net/url_request/url_fetcher.h"
+#include "net/url_request/url_fetcher_response_writer.h"
+#include "net/url_request/url_request_context.h"
+#include "net/url_request/url_request_context_builder.h"
+#include "net/url_request/url_request_context_getter.h"
+
+namespace media {
+
+namespace {
+
+const int kHttpOK = 200;
+const int kHttpRangeNotSatisfiable = 416;
+
+struct DiskCacheConfig {
+  DiskCacheConfig() : max_bytes(0), applied(false) {}
+
+  base::Lock lock;
+  base::FilePath path;
+  int max_bytes;
+  // The request context was built, changes come too late.
+  bool applied;
+};
+
+base::LazyInstance<DiskCacheConfig>::Leaky g_disk_cache_config =
+    LAZY_INSTANCE_INITIALIZER;
+
+struct RequestContextInitializer {
+  RequestContextInitializer() {
+    net::URLRequestContextBuilder builder;
+    builder.set_data_enabled(true);
+    builder.set_file_enabled(true);
+    DiskCacheConfig* config = g_disk_cache_config.Pointer();
+    base::AutoLock auto_lock(config->lock);
+    config->applied = true;
+    if (!config->path.empty()) {
+      // Partial responses are kept as sparse entries with their validators,
+      // stale ranges are revalidated with conditional range requests.
+      net::URLRequestContextBuilder::HttpCacheParams cache_params;
+      cache_params.type = net::URLRequestContextBuilder::HttpCacheParams::DISK;
+      cache_params.path = config->path;
+      cache_params.max_size = config->max_bytes;
+      builder.EnableHttpCache(cache_params);
+      LOG(INFO) << "HTTP disk cache at " << config->path.value();
+    }
+    builder.set_proxy_config_service(base::WrapUnique(
+        new net::ProxyConfigServiceFixed(net::ProxyConfig::CreateDirect())));
+    url_request_context_ = builder.Build();
+  }
+
+  ~RequestContextInitializer() {}
+
+  net::URLRequestContext* request_context() {
+    return url_request_context_.get();
+  }
+
+  std::unique_ptr<net::URLRequestContext> url_request_context_;
+};
+
+base::LazyInstance<RequestContextInitializer>::Leaky g_request_context_init =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+class ResourceFetcher::WriterBridge : public net::URLFetcherResponseWriter {
+ public:
+  explicit WriterBridge(ResourceFetcher* fetcher) : fetcher_(fetcher) {}
+
+  ~WriterBridge() override {}
+
+  int Initialize(const net::CompletionCallback& callback) override {
+    fetcher_->DidInitialize();
+    return 0;
+  }
+
+  int Write(net::IOBuffer* buffer,
+            int num_bytes,
+            const net::CompletionCallback& callback) override {
+    return fetcher_->OnWrite(buffer, num_bytes);
+  }
+
+  int Finish(int net_error, const net::CompletionCallback& callback) override {
+    fetcher_->OnFinish(net_error);
+    return 0;
+  }
+
+ private:
+  ResourceFetcher* fetcher_;
+};
+
+ResourceFetcher::ResourceFetcher(
+    Delegate* delegate,
+    const GURL& url,
+    int64_t first,
+    int64_t last,
+    const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner)
+    : delegate_(delegate),
+      url_(url),
+      first_(first),
+      last_(last),
+      io_task_runner_(io_task_runner),
+      position_(first),
+      response_started_(false) {}
+
+ResourceFetcher::~ResourceFetcher() {}
+
+// static
+void ResourceFetcher::EnableDiskCache(const base::FilePath& path,
+                                      int max_bytes) {
+  DiskCacheConfig* config = g_disk_cache_config.Pointer();
+  base::AutoLock auto_lock(config->lock);
+  if (config->applied) {
+    LOG_IF(WARNING, path != config->path || max_bytes != config->max_bytes)
+        << "HTTP disk cache " << path.value()
+        << " ignored, the request context exists already";
+    return;
+  }
+  config->path = path;
+  config->max_bytes = max_bytes;
+}
+
+// static
+void ResourceFetcher::Preconnect(const GURL& url, int num_streams) {
+  if (!url.SchemeIsHTTPOrHTTPS())
+    return;
+  net::HttpTransactionFactory* factory =
+      g_request_context_init.Pointer()
+          ->request_context()
+          ->http_transaction_factory();
+  if (!factory || !factory->GetSession())
+    return;
+  net::HttpRequestInfo request_info;
+  request_info.url = url;
+  request_info.method = "GET";
+  request_info.load_flags = net::LOAD_NORMAL;
+  request_info.privacy_mode = net::PRIVACY_MODE_DISABLED;
+  factory->GetSession()->http_stream_factory()->PreconnectStreams(
+      num_streams, request_info);
+}
+
+void ResourceFetcher::Start() {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
+  DCHECK(!fetcher_);
+  fetcher_ = net::URLFetcher::Create(url_, net::URLFetcher::GET, this);
+  fetcher_->SetRequestContext(new net::TrivialURLRequestContextGetter(
+      g_request_context_init.Pointer()->request_context(), io_task_runner_));
+  fetcher_->SetExtraRequestHeaders(
+      "Accept-Encoding: identity;q=1, *;q=0\r\nUser-Agent:Mozilla/5.0 (X11; "
+      "Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+      "Chrome/59.0.3071.115 Safari/537.36\r\n");
+  fetcher_->SaveResponseWithWriter(base::MakeUnique<WriterBridge>(this));
+  std::stringstream range_header;
+  range_header << "Range: "
+               << "bytes=" << first_ << "-";
+  if (last_ >= 0)
+    range_header << last_;
+  LOG(INFO) << "ResourceFetcher range=" << range_header.str();
+  fetcher_->AddExtraRequestHeader(range_header.str());
+  fetcher_->Start();
+}
+
+int ResourceFetcher::GetResponseCode() const {
+  return fetcher_->GetResponseCode();
+}
+
+net::HttpResponseHeaders* ResourceFetcher::GetResponseHeaders() const {
+  return fetcher_->GetResponseHeaders();
+}
+
+void ResourceFetcher::OnURLFetchComplete(const net::URLFetcher* source) {
+  LOG(INFO) << "OnURLFetchComplete source=" << source
+            << " fetcher_=" << fetcher_.get();
+}
+
+void ResourceFetcher::DidInitialize() {
+  // A retry starts over, its response is reported again.
+  position_ = first_;
+  response_started_ = false;
+}
+
+void ResourceFetcher::OnResponseStarted() {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
+  response_started_ = true;
+  // A server without range support sends the whole resource. Its bytes
+  // must not be stored at |first_|.
+  if (GetResponseCode() == kHttpOK && first_ > 0) {
+    LOG(INFO) << "ResourceFetcher range ignored, first=" << first_;
+    position_ = 0;
+  }
+  delegate_->OnFetcherStarted(this);
+}
+
+int ResourceFetcher::OnWrite(net::IOBuffer* buffer, int num_bytes) {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
+  // The headers are known from the first write on, not yet in
+  // DidInitialize().
+  if (!response_started_)
+    OnResponseStarted();
+  delegate_->OnFetcherWrite(this, position_,
+                            reinterpret_cast<const uint8_t*>(buffer->data()),
+                            num_bytes);
+  position_ += num_bytes;
+  return num_bytes;
+}
+
+void ResourceFetcher::OnFinish(int net_error) {
+  LOG(INFO) << "ResourceFetcher::OnFinish error=" << net_error
+            << " cached=" << fetcher_->WasCached();
+  // An empty body or a failed request, the delegate still gets to see
+  // whatever headers came.
+  if (!response_started_)
+    OnResponseStarted();
+  // E.g. a 416 for a range at or past the end. It writes nothing the
+  // reader waits for, a retry would get the same answer.
+  if (net_error == net::OK && GetResponseCode() / 100 != 2) {
+    net_error = GetResponseCode() == kHttpRangeNotSatisfiable
+                    ? net::ERR_REQUEST_RANGE_NOT_SATISFIABLE
+                    : net::ERR_FAILED;
+  }
+  delegate_->OnFetcherDone(this, net_error);
+}
+
+}  // namespace media
@@ -0,0 +1,104 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+#ifndef CHROMIUM_MEDIA_LIB_RESOURCE_FETCHER_H_
+#define CHROMIUM_MEDIA_LIB_RESOURCE_FETCHER_H_
+
+#include <memory>
+
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/single_thread_task_runner.h"
+#include "net/base/io_buffer.h"
+#include "net/url_request/url_fetcher_delegate.h"
+#include "url/gurl.h"
+
+namespace net {
+class HttpResponseHeaders;
+class URLFetcher;
+}
+
+namespace media {
+
+// One HTTP range request of a ResourceMultiBuffer, used on the IO thread.
+// Every write is reported with its position in the resource, so the data
+// of a request which is being replaced can't be taken for data of its
+// successor.
+class ResourceFetcher : public net::URLFetcherDelegate {
+ public:
+  class Delegate {
+   public:
+    // The response headers arrived, before the first byte of the body is
+    // written. position() already tells whether the range was honoured.
+    // Also reported for requests which fail without a response.
+    virtual void OnFetcherStarted(ResourceFetcher* fetcher) = 0;
+    virtual void OnFetcherWrite(ResourceFetcher* fetcher,
+                                int64_t position,
+                                const uint8_t* data,
+                                int size) = 0;
+    // The request completed, or failed with |net_error|. |fetcher| must not
+    // be deleted from within the call.
+    virtual void OnFetcherDone(ResourceFetcher* fetcher, int net_error) = 0;
+
+   protected:
+    virtual ~Delegate() {}
+  };
+
+  // Fetches bytes |first| to |last| of |url|, |last| is -1 to fetch up to
+  // the end.
+  ResourceFetcher(
+      Delegate* delegate,
+      const GURL& url,
+      int64_t first,
+      int64_t last,
+      const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner);
+  ~ResourceFetcher() override;
+
+  // Keeps fetched resources in an HTTP disk cache at |path| of up to
+  // |max_bytes|, so that they survive restarts of the process. Must be
+  // called before the first fetch or preconnect, later calls asking for
+  // another cache are ignored with a warning.
+  static void EnableDiskCache(const base::FilePath& path, int max_bytes);
+  // Resolves the host of |url| and connects until |num_streams| sockets to
+  // it are open or connecting, so that fetches started later don't wait
+  // for a connection. Called on the IO thread.
+  static void Preconnect(const GURL& url, int num_streams);
+
+  void Start();
+
+  int64_t first() const { return first_; }
+  int64_t last() const { return last_; }
+  // Position of the next byte written. Starts at 0 instead of |first| if
+  // the server ignored the range.
+  int64_t position() const { return position_; }
+
+  int GetResponseCode() const;
+  net::HttpResponseHeaders* GetResponseHeaders() const;
+
+  // net::URLFetcherDelegate
+  void OnURLFetchComplete(const net::URLFetcher* source) override;
+
+ private:
+  class WriterBridge;
+
+  // The request is (re)started, URLFetcher calls this before it is sent.
+  void DidInitialize();
+  // Runs once per request, when the response code and headers are known.
+  void OnResponseStarted();
+  int OnWrite(net::IOBuffer* buffer, int num_bytes);
+  void OnFinish(int net_error);
+
+  Delegate* delegate_;
+  const GURL url_;
+  const int64_t first_;
+  const int64_t last_;
+  const scoped_refptr<base::SingleThreadTaskRunner> io_task_runner_;
+  int64_t position_;
+  bool response_started_;
+  std::unique_ptr<net::URLFetcher> fetcher_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResourceFetcher);
+};
+
+}  // namespace media
+
+#endif  // CHROMIUM_MEDIA_LIB_RESOURCE_FETCHER_H_
@@ -1,292 +1,595 @@
 #include "chromium_media_lib/resource_multibuffer.h"
 
-#include "base/lazy_instance.h"
+#include <algorithm>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/memory/ptr_util.h"
+#include "base/synchronization/waitable_event.h"
+#include "net/base/net_errors.h"
 #include "net/http/http_response_headers.h"
-#include "net/proxy/proxy_config_service_fixed.h"
-#include "net/url_request/url_fetcher.h"
-#include "net/url_request/url_fetcher_response_writer.h"
-#include "net/url_request/url_request_context.h"
-#include "net/url_request/url_request_context_builder.h"
-#include "net/url_request/url_request_context_getter.h"
 
 namespace media {
 
+static const int kHttpOK = 200;
 static const int kHttpPartialContent = 206;
 
-// This is the size of the look-ahead region.
-static const int kMaxLookAheadIndex = 5;
-// This is the size of the look-behind region.
-static const int kMaxLookBehindIndex = 50;
-static const int kMaxWaitForReaderOffset = 512 * 1024;  // 512 kb
-static const int kMaxCacheSize = 1000;
-
-struct RequestContextInitializer {
-  RequestContextInitializer() {
-    net::URLRequestContextBuilder builder;
-    builder.set_data_enabled(true);
-    builder.set_file_enabled(true);
-    builder.set_proxy_config_service(base::WrapUnique(
-        new net::ProxyConfigServiceFixed(net::ProxyConfig::CreateDirect())));
-    url_request_context_ = builder.Build();
-  }
-
-  ~RequestContextInitializer() {}
-
-  net::URLRequestContext* request_context() {
-    return url_request_context_.get();
-  }
-
-  std::unique_ptr<net::URLRequestContext> url_request_context_;
-};
-
-class URLFetcherResponseWriterBridge : public net::URLFetcherResponseWriter {
- public:
-  URLFetcherResponseWriterBridge(ResourceMultiBuffer* buffer)
-      : buffer_(buffer) {}
-
-  ~URLFetcherResponseWriterBridge() override {}
-
-  int Initialize(const net::CompletionCallback& callback) override {
-    buffer_->DidInitialize();
-    return 0;
-  }
-
-  int Write(net::IOBuffer* buffer,
-            int num_bytes,
-            const net::CompletionCallback& callback) override {
-    return buffer_->OnWrite(buffer, num_bytes, callback);
-  }
-
-  int Finish(int net_error, const net::CompletionCallback& callback) override {
-    buffer_->OnFinish(net_error, callback);
-    return 0;
-  }
-
- private:
-  ResourceMultiBuffer* buffer_;
-};
-
-static base::LazyInstance<RequestContextInitializer>::Leaky
-    g_request_context_init = LAZY_INSTANCE_INITIALIZER;
+// Pinned blocks and wait-for-reader threshold until the bitrate is known.
+static const int kDefaultLookBehindBlocks = 5;
+static const int kDefaultLookAheadBlocks = 50;
+static const int kDefaultWaitForReaderBytes = 512 * 1024;  // 512 kb
+// Once the bitrate is known, seconds of media pinned behind the reader and
+// within reach of the current fetch.
+static const int kLookBehindSeconds = 5;
+static const int kWaitForReaderSeconds = 2;
+// Bounds of the bitrate-driven values, so that odd bitrates can neither
+// pin a fraction of a block nor a large share of the shared cache.
+static const int64_t kMinWaitForReaderBytes = 64 * 1024;
+static const int64_t kMaxPinnedBytes = 64 * 1024 * 1024;
+// Ranges fetched ahead of the reader per parallel fetcher.
+static const int kRangesAheadPerFetcher = 2;
+// Failed range requests in a row before reads fail.
+static const int kMaxRangeFailures = 3;
+// Bytes a replaced stream may still write, mostly what is on the wire
+// already. Cheaper than a reconnect if the reader comes back, as the
+// demuxer does after probing the index at the end of a file.
+static const int64_t kMaxDrainBytes = 1024 * 1024;
+
+ResourceMultiBuffer::Options::Options()
+    : parallel_fetchers(0),
+      fetch_range_size(1024 * 1024),
+      buffer_seconds(30),
+      eviction_policy(ResourceEvictionPolicy::kLeastRecentlyUsed) {}
+
+ResourceMultiBuffer::Stream::Stream()
+    : id(0), start(0), position(0), finished(false), error(net::OK) {}
 
 ResourceMultiBuffer::ResourceMultiBuffer(
     ResourceMultiBufferClient* client,
     const GURL& url,
     int32_t block_size_shift,
-    const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner)
+    const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner,
+    const Options& options)
     : url_(url),
       io_task_runner_(io_task_runner),
-      write_start_pos_(0),
-      write_offset_(0),
-      total_bytes_(-1),
+      options_(options),
+      started_(false),
+      playhead_(0),
+      drain_end_(0),
+      next_stream_id_(0),
+      range_failures_(0),
+      range_schedule_pending_(false),
+      range_supported_(true),
+      look_behind_blocks_(kDefaultLookBehindBlocks),
+      look_ahead_blocks_(kDefaultLookAheadBlocks),
+      wait_for_reader_bytes_(kDefaultWaitForReaderBytes),
+      block_size_shift_(block_size_shift),
+      cache_(ResourceBlockCache::Acquire(url,
+                                         block_size_shift,
+                                         options.eviction_policy,
+                                         this)),
       client_(client),
-      block_size_shift_(block_size_shift) {}
+      wait_position_(-1),
+      writer_removed_(false) {}
+
+ResourceMultiBuffer::~ResourceMultiBuffer() {
+  // The fetchers belong to the IO thread and tasks queued there refer to
+  // |this|. The shutdown task runs after all of them.
+  if (io_task_runner_->BelongsToCurrentThread()) {
+    ShutdownOnIOThread(nullptr);
+  } else {
+    base::WaitableEvent done(base::WaitableEvent::ResetPolicy::MANUAL,
+                             base::WaitableEvent::InitialState::NOT_SIGNALED);
+    if (io_task_runner_->PostTask(
+            FROM_HERE, base::Bind(&ResourceMultiBuffer::ShutdownOnIOThread,
+                                  base::Unretained(this), &done))) {
+      done.Wait();
+    }
+  }
+  cache_->Release(this);
+}
 
-ResourceMultiBuffer::~ResourceMultiBuffer() {}
+bool ResourceMultiBuffer::IsStreaming() {
+  base::AutoLock auto_lock(lock_);
+  return !range_supported_;
+}
 
 void ResourceMultiBuffer::Start() {
-  DCHECK(!fetcher_);
+  // Connect a socket beyond those of the fetches starting now, for the
+  // seek demuxers do right away to read an index at the end of the file.
+  const int streams =
+      (options_.parallel_fetchers > 0 ? options_.parallel_fetchers : 1) + 1;
+  io_task_runner_->PostTask(
+      FROM_HERE, base::Bind(&ResourceFetcher::Preconnect, url_, streams));
   base::AutoLock auto_lock(lock_);
-  write_start_pos_ = 0;
-  write_offset_ = 0;
-  CreateFetcherFrom(0);
+  started_ = true;
+  if (UsesRangeFetches()) {
+    range_schedule_pending_ = true;
+    io_task_runner_->PostTask(
+        FROM_HERE, base::Bind(&ResourceMultiBuffer::ScheduleRangeFetches,
+                              base::Unretained(this)));
+    return;
+  }
+  StartStream(0);
+}
+
+void ResourceMultiBuffer::Detach() {
+  base::AutoLock auto_lock(wait_lock_);
+  client_ = nullptr;
 }
 
-MultiBufferBlockId ResourceMultiBuffer::ToBlockId(int position) {
+MultiBufferBlockId ResourceMultiBuffer::ToBlockId(int64_t position) {
   return position >> block_size_shift_;
 }
 
+int64_t ResourceMultiBuffer::ToPosition(MultiBufferBlockId id) const {
+  return id << block_size_shift_;
+}
+
 int64_t ResourceMultiBuffer::GetSize() {
   base::AutoLock auto_lock(lock_);
-  if (!fetcher_)
+  if (!started_)
     return -1;
-  return total_bytes_;
+  return cache_->GetTotalBytes();
 }
 
-bool ResourceMultiBuffer::CheckCacheMiss(int position) {
-  MultiBufferBlockId id = ToBlockId(position);
-  auto i = cache_.upper_bound(id);
-  bool write_behind = write_start_pos_ + write_offset_ > position;
-  // the writer write entry is being purged
-  if (!write_behind)
-    return false;
-  if (i == cache_.begin())
-    return true;
-  --i;
-  bool no_cache_entry =
-      !((i->first << block_size_shift_) + i->second->data_size() > position);
-  return no_cache_entry && write_behind;
+void ResourceMultiBuffer::SetBitrate(int bitrate) {
+  if (bitrate <= 0 || options_.buffer_seconds <= 0)
+    return;
+  base::AutoLock auto_lock(lock_);
+  const int64_t bytes_per_second = bitrate / 8;
+  const int64_t max_pinned_blocks = kMaxPinnedBytes >> block_size_shift_;
+  look_ahead_blocks_ = std::min(
+      max_pinned_blocks,
+      ToBlockId(bytes_per_second * options_.buffer_seconds) + 1);
+  look_behind_blocks_ = std::min(
+      max_pinned_blocks, ToBlockId(bytes_per_second * kLookBehindSeconds) + 1);
+  wait_for_reader_bytes_ = std::max(
+      kMinWaitForReaderBytes, bytes_per_second * kWaitForReaderSeconds);
+  LOG(INFO) << "SetBitrate bitrate=" << bitrate
+            << " look_ahead_blocks=" << look_ahead_blocks_
+            << " look_behind_blocks=" << look_behind_blocks_
+            << " wait_for_reader_bytes=" << wait_for_reader_bytes_;
+  if (started_)
+    AdjustPinnedRange(ToBlockId(playhead_));
 }
 
-void ResourceMultiBuffer::Seek(int position) {
+void ResourceMultiBuffer::Seek(int64_t position) {
   base::AutoLock auto_lock(lock_);
-  int current_write_pos = write_start_pos_ + write_offset_;
   MultiBufferBlockId id = ToBlockId(position);
+  playhead_ = position;
   AdjustPinnedRange(id);
-  if (position < write_start_pos_ ||
-      position - kMaxWaitForReaderOffset > current_write_pos ||
-      CheckCacheMiss(position)) {
-    id = std::max(id - 1, 0);
-    write_start_pos_ = id << block_size_shift_;
-    write_offset_ = 0;
-    CreateFetcherFrom(write_start_pos_);
+  // The range requests follow the reader on their own.
+  if (UsesRangeFetches() && !range_schedule_pending_) {
+    range_schedule_pending_ = true;
+    io_task_runner_->PostTask(
+        FROM_HERE, base::Bind(&ResourceMultiBuffer::ScheduleRangeFetches,
+                              base::Unretained(this)));
   }
-  // otherwise it is ok to acces data or wait data received
+  if (cache_->GetAvailableEnd(position) > position)
+    return;
+  // Spilled to disk, much closer than the network.
+  if (cache_->LoadFromDisk(position))
+    return;
+  int64_t total_bytes = cache_->GetTotalBytes();
+  if (total_bytes >= 0 && position >= total_bytes)
+    return;
+  if (UsesRangeFetches())
+    return;
+  if (!range_supported_) {
+    // Fill() reports why the stream won't get there.
+    if (stream_.id && stream_.finished && stream_.error != net::OK)
+      return;
+    // A new request starts over at 0 as well, the running one gets to
+    // |position| first.
+    if (stream_.id && !stream_.finished && stream_.position <= position)
+      return;
+    // The data was dropped after the stream passed it, the stream would
+    // only come back after the whole download. Start over right away.
+    StartStream(0);
+    return;
+  }
+  // Forward jumps within reach are served by streaming through, the bytes
+  // skipped are cached on the way.
+  if (IsNear(stream_, position)) {
+    // |stream_| gets there soon, or Fill() reports why it won't.
+    if (!stream_.finished || stream_.error != net::OK)
+      return;
+  }
+  // Back to where the replaced stream still drains, e.g. after the demuxer
+  // probed the end of the file. Resume it instead of reconnecting.
+  if (!draining_.finished && IsNear(draining_, position)) {
+    LOG(INFO) << "Resume stream id=" << draining_.id;
+    std::swap(stream_, draining_);
+    drain_end_ = draining_.position + kMaxDrainBytes;
+    cache_->SetWriterPosition(this, stream_.position);
+    return;
+  }
+  // Another player already fetches the data just before |position|.
+  if (cache_->HasOtherWriterIn(this, position - wait_for_reader_bytes_,
+                               position)) {
+    StopStream();
+    return;
+  }
+  id = std::max<MultiBufferBlockId>(id - 1, 0);
+  // Don't download again what is cached already.
+  StartStream(cache_->GetAvailableEnd(ToPosition(id)));
 }
 
-int ResourceMultiBuffer::Fill(int position, int size, void* data) {
+int ResourceMultiBuffer::Fill(int64_t position, int size, void* data) {
+  int write_bytes =
+      cache_->Fill(position, size, static_cast<uint8_t*>(data));
+  if (write_bytes > 0)
+    return write_bytes;
+  // A failed fetch won't bring the data, don't leave the reader waiting.
   base::AutoLock auto_lock(lock_);
-  MultiBufferBlockId id = ToBlockId(position);
-  const int buffer_size = 1 << block_size_shift_;
-  auto it = cache_.upper_bound(id);
-  DCHECK(it == cache_.end() || (it->first << block_size_shift_) > position);
-  if (it == cache_.begin()) {
-    return net::ERR_IO_PENDING;
+  if (stream_.finished && stream_.error != net::OK)
+    return stream_.error;
+  return net::ERR_IO_PENDING;
+}
+
+bool ResourceMultiBuffer::NotifyWhenAvailable(int64_t position) {
+  // Arm first, so that a write racing with the check below still notifies.
+  {
+    base::AutoLock auto_lock(wait_lock_);
+    // E.g. the disk load Seek() relied on failed before the reader got
+    // here, nothing would wake it up.
+    if (writer_removed_) {
+      writer_removed_ = false;
+      return false;
+    }
+    wait_position_ = position;
   }
-  --it;
-  int write_bytes = 0;
-  int index = it->first;
-  DCHECK_LE(it->first << block_size_shift_, position);
-  while (it != cache_.end() && size > 0 &&
-         ((it->first << block_size_shift_) + it->second->data_size() >=
-          position) &&
-         index == it->first) {
-    // copy buffer
-    const int start_position = position - (it->first << block_size_shift_);
-    const int remain_size =
-        std::min(it->second->data_size() - start_position, size);
-    DCHECK(remain_size >= 0);
-    uint8_t* p = (uint8_t*)data + write_bytes;
-    memcpy(p, it->second->data() + start_position, remain_size);
-    size -= remain_size;
-    position += remain_size;
-    write_bytes += remain_size;
-    // the buffer is not full, so need to wait until ready.
-    if (it->second->data_size() != buffer_size)
-      break;
-    ++it;
-    ++index;
+  if (cache_->GetAvailableEnd(position) == position)
+    return true;
+  base::AutoLock auto_lock(wait_lock_);
+  wait_position_ = -1;
+  return false;
+}
+
+void ResourceMultiBuffer::OnFetcherStarted(ResourceFetcher* fetcher) {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
+  // The demuxer asks for the size as soon as it is initialized, so it is
+  // taken from the headers before the first byte is stored.
+  UpdateTotalBytes(fetcher);
+  // Every request asks for a range, the response code is known by now. A
+  // 200 to one starting at 0 is fine if the server announces range support.
+  net::HttpResponseHeaders* headers = fetcher->GetResponseHeaders();
+  if (fetcher->GetResponseCode() == kHttpOK &&
+      (fetcher->first() > 0 || !headers ||
+       !headers->HasHeaderValue("Accept-Ranges", "bytes"))) {
+    OnRangesUnsupported(fetcher);
   }
+  base::AutoLock auto_lock(wait_lock_);
+  if (client_)
+    client_->DidInitialize();
+}
 
-  return write_bytes > 0 ? write_bytes : net::ERR_IO_PENDING;
+void ResourceMultiBuffer::OnFetcherWrite(ResourceFetcher* fetcher,
+                                         int64_t position,
+                                         const uint8_t* data,
+                                         int size) {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
+  LOG(INFO) << "OnFetcherWrite position=" << position << " size=" << size;
+  // http 2XX
+  if (fetcher->GetResponseCode() / 100 != 2)
+    return;
+  // Data of a replaced or stopped fetcher is still good for the cache. The
+  // copy doesn't need |lock_|, readers and seeks aren't held up by it.
+  cache_->Write(this, position, data, size);
+  if (UsesRangeFetches())
+    return;
+  base::AutoLock auto_lock(lock_);
+  int id = FindFetcherId(fetcher);
+  if (id && id == draining_.id && !draining_.finished) {
+    draining_.position = position + size;
+    if (draining_.position >= drain_end_)
+      StopDraining();
+    return;
+  }
+  if (!id || id != stream_.id || stream_.finished)
+    return;
+  stream_.position = position + size;
+  // Another player's fetch is just ahead, it brings what comes next.
+  if (cache_->HasOtherWriterIn(this, stream_.position + 1,
+                               stream_.position + wait_for_reader_bytes_)) {
+    StopStream();
+  }
 }
 
-void ResourceMultiBuffer::OnURLFetchComplete(const net::URLFetcher* source) {
-  LOG(INFO) << "OnURLFetchComplete source=" << source
-            << " fetcher_=" << fetcher_.get();
+void ResourceMultiBuffer::OnFetcherDone(ResourceFetcher* fetcher,
+                                        int net_error) {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
+  // Servers which send neither Content-Length nor Content-Range tell the
+  // size by completing a request open to the end, or a 200 to any range.
+  if (net_error == net::OK &&
+      (fetcher->last() < 0 || fetcher->GetResponseCode() == kHttpOK) &&
+      cache_->GetTotalBytes() < 0) {
+    cache_->SetTotalBytes(fetcher->position());
+  }
+  if (UsesRangeFetches()) {
+    auto it = std::find_if(
+        range_fetchers_.begin(), range_fetchers_.end(),
+        [fetcher](const std::unique_ptr<ResourceFetcher>& range_fetcher) {
+          return range_fetcher.get() == fetcher;
+        });
+    if (it == range_fetchers_.end())
+      return;
+    // Not from within its own callback.
+    io_task_runner_->DeleteSoon(FROM_HERE, it->release());
+    range_fetchers_.erase(it);
+    {
+      base::AutoLock auto_lock(lock_);
+      if (net_error == net::OK) {
+        range_failures_ = 0;
+      } else if (++range_failures_ >= kMaxRangeFailures) {
+        stream_.finished = true;
+        stream_.error = net_error;
+      }
+    }
+    ScheduleRangeFetches();
+    NotifyClient();
+    return;
+  }
+  {
+    base::AutoLock auto_lock(lock_);
+    int id = FindFetcherId(fetcher);
+    if (id && id == draining_.id)
+      draining_.finished = true;
+    if (!id || id != stream_.id || stream_.finished)
+      return;
+    stream_.finished = true;
+    stream_.error = net_error;
+    cache_->SetWriterPosition(this, -1);
+  }
+  NotifyClient();
+}
+
+void ResourceMultiBuffer::OnBlocksWritten(int64_t start, int64_t end) {
+  base::AutoLock auto_lock(wait_lock_);
+  if (wait_position_ < start || wait_position_ >= end)
+    return;
+  wait_position_ = -1;
+  if (client_)
+    client_->OnUpdateState();
+}
+
+void ResourceMultiBuffer::OnWriterRemoved() {
+  base::AutoLock auto_lock(wait_lock_);
+  if (wait_position_ < 0) {
+    writer_removed_ = true;
+    return;
+  }
+  // Let the reader decide whether to fetch the data itself.
+  wait_position_ = -1;
+  if (client_)
+    client_->OnUpdateState();
+}
+
+void ResourceMultiBuffer::NotifyClient() {
+  base::AutoLock auto_lock(wait_lock_);
+  wait_position_ = -1;
+  if (client_)
+    client_->OnUpdateState();
 }
 
-void ResourceMultiBuffer::DidInitialize() {
-  client_->DidInitialize();
+void ResourceMultiBuffer::AdjustPinnedRange(MultiBufferBlockId id) {
+  MultiBufferBlockId first =
+      std::max<MultiBufferBlockId>(id - look_behind_blocks_, 0);
+  MultiBufferBlockId last = id + look_ahead_blocks_;
+  // Keep what the range requests fetch ahead until the reader gets there.
+  if (UsesRangeFetches())
+    last = std::max(last, ToBlockId(ToPosition(id) + GetRangeWindow()));
+  cache_->SetPinnedRange(this, id, first, last);
+  LOG(INFO) << "!!!! id=" << id << " range=" << first << "-" << last;
+}
+
+bool ResourceMultiBuffer::IsNear(const Stream& stream,
+                                 int64_t position) const {
+  lock_.AssertAcquired();
+  return stream.id && position >= stream.start &&
+         position - wait_for_reader_bytes_ <= stream.position;
+}
+
+void ResourceMultiBuffer::UpdateTotalBytes(ResourceFetcher* fetcher) {
+  if (fetcher->GetResponseCode() / 100 != 2)
+    return;
+  net::HttpResponseHeaders* headers = fetcher->GetResponseHeaders();
+  if (!headers)
+    return;
+  if (fetcher->GetResponseCode() == kHttpPartialContent) {
+    int64_t first_byte_pos, last_byte_pos, instance_length;
+    if (headers->GetContentRangeFor206(&first_byte_pos, &last_byte_pos,
+                                       &instance_length)) {
+      cache_->SetTotalBytes(instance_length);
+    }
+    return;
+  }
+  int64_t content_length = headers->GetContentLength();
+  if (content_length >= 0)
+    cache_->SetTotalBytes(content_length);
 }
 
-int ResourceMultiBuffer::OnWrite(net::IOBuffer* buffer,
-                                 int num_bytes,
-                                 const net::CompletionCallback& callback) {
+void ResourceMultiBuffer::OnRangesUnsupported(ResourceFetcher* fetcher) {
   DCHECK(io_task_runner_->BelongsToCurrentThread());
+  base::AutoLock auto_lock(lock_);
+  if (range_supported_)
+    LOG(INFO) << "Range requests unsupported, streaming from the start";
+  range_supported_ = false;
+  if (options_.parallel_fetchers > 0) {
+    auto it = std::find_if(
+        range_fetchers_.begin(), range_fetchers_.end(),
+        [fetcher](const std::unique_ptr<ResourceFetcher>& range_fetcher) {
+          return range_fetcher.get() == fetcher;
+        });
+    if (it == range_fetchers_.end())
+      return;
+    std::unique_ptr<ResourceFetcher> stream_fetcher = std::move(*it);
+    range_fetchers_.clear();
+    StopDraining();
+    stream_ = Stream();
+    stream_.id = ++next_stream_id_;
+    fetchers_[stream_.id] = std::move(stream_fetcher);
+    cache_->SetWriterPosition(this, 0);
+    return;
+  }
+  int id = FindFetcherId(fetcher);
+  if (id && id == stream_.id) {
+    stream_.start = 0;
+    stream_.position = 0;
+    cache_->SetWriterPosition(this, 0);
+  } else if (id && id == draining_.id) {
+    StopDraining();
+  }
+}
 
-  // int written = net::ERR_ABORTED;
-  // http 2XX
-  int written_bytes = num_bytes;
-  LOG(INFO) << "write_offset=" << write_offset_ << " num_bytes=" << num_bytes;
+bool ResourceMultiBuffer::UsesRangeFetches() const {
+  return options_.parallel_fetchers > 0 && range_supported_;
+}
+
+void ResourceMultiBuffer::StartStream(int64_t position) {
+  lock_.AssertAcquired();
+  StopDraining();
+  if (stream_.id && !stream_.finished) {
+    draining_ = stream_;
+    drain_end_ = draining_.position + kMaxDrainBytes;
+  }
+  stream_ = Stream();
+  stream_.id = ++next_stream_id_;
+  stream_.start = position;
+  stream_.position = position;
+  LOG(INFO) << "StartStream id=" << stream_.id << " position=" << position;
+  cache_->SetWriterPosition(this, position);
+  io_task_runner_->PostTask(
+      FROM_HERE, base::Bind(&ResourceMultiBuffer::CreateFetcher,
+                            base::Unretained(this), stream_.id, position));
+}
+
+void ResourceMultiBuffer::StopStream() {
+  lock_.AssertAcquired();
+  if (stream_.finished)
+    return;
+  LOG(INFO) << "StopStream at=" << stream_.position;
+  stream_.finished = true;
+  stream_.error = net::OK;
+  cache_->SetWriterPosition(this, -1);
+  // Not from within the callbacks of the fetcher.
+  io_task_runner_->PostTask(
+      FROM_HERE, base::Bind(&ResourceMultiBuffer::DropFetcher,
+                            base::Unretained(this), stream_.id));
+}
+
+void ResourceMultiBuffer::StopDraining() {
+  lock_.AssertAcquired();
+  if (!draining_.id)
+    return;
+  io_task_runner_->PostTask(
+      FROM_HERE, base::Bind(&ResourceMultiBuffer::DropFetcher,
+                            base::Unretained(this), draining_.id));
+  draining_ = Stream();
+}
+
+void ResourceMultiBuffer::CreateFetcher(int id, int64_t position) {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
   {
     base::AutoLock auto_lock(lock_);
-    bool partial_response = fetcher_->GetResponseCode() == kHttpPartialContent;
-    if (fetcher_->GetResponseCode() / 100 == 2) {
-      if (partial_response) {
-        net::HttpResponseHeaders* headers = fetcher_->GetResponseHeaders();
-        int64_t first_byte_pos, last_byte_pos, instance_length;
-        bool success = headers->GetContentRangeFor206(
-            &first_byte_pos, &last_byte_pos, &instance_length);
-        if (success)
-          total_bytes_ = instance_length;
-      } else {
-        total_bytes_ = fetcher_->GetReceivedResponseContentLength();
-      }
-      MultiBufferBlockId id = ToBlockId(write_start_pos_ + write_offset_);
-      const int buffer_size = 1 << block_size_shift_;
-      char* read_data = buffer->data();
-      while (num_bytes > 0) {
-        scoped_refptr<DataBuffer> entry;
-        auto found = cache_.find(id);
-        if (found == cache_.end()) {
-          entry = new DataBuffer(buffer_size);
-          cache_[id] = entry;
-          lru_.Insert(id);
-          PurgeIfNecessary();
-        } else {
-          entry = found->second;
-          lru_.Use(id);
-        }
-        int write_start = ((write_start_pos_ + write_offset_) &
-                           ((1 << block_size_shift_) - 1));
-        int remain_size = std::min(buffer_size - write_start, num_bytes);
-        memcpy(entry->writable_data() + write_start, read_data, remain_size);
-        entry->set_data_size(write_start + remain_size);
-        LOG(INFO) << "id=" << id
-                  << " data_size=" << (write_start + remain_size);
-        read_data += remain_size;
-        write_offset_ += remain_size;
-        num_bytes -= remain_size;
-        id++;
-      }
+    // Replaced again before it could start.
+    if (id != stream_.id && id != draining_.id)
+      return;
+    // Streams which completed on their own.
+    for (auto it = fetchers_.begin(); it != fetchers_.end();) {
+      if (it->first != stream_.id && it->first != draining_.id)
+        it = fetchers_.erase(it);
+      else
+        ++it;
     }
   }
-  // client_->OnUpdateState();
-  return written_bytes;
+  std::unique_ptr<ResourceFetcher>& fetcher = fetchers_[id];
+  fetcher = base::MakeUnique<ResourceFetcher>(this, url_, position, -1,
+                                              io_task_runner_);
+  fetcher->Start();
 }
 
-int ResourceMultiBuffer::OnFinish(int net_error,
-                                  const net::CompletionCallback& callback) {
-  LOG(INFO) << "ResourceDataSource::OnFinish error=" << net_error;
-  client_->OnUpdateState();
-  return 0;
+void ResourceMultiBuffer::ShutdownOnIOThread(base::WaitableEvent* done) {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
+  fetchers_.clear();
+  range_fetchers_.clear();
+  if (done)
+    done->Signal();
 }
 
-void ResourceMultiBuffer::AdjustPinnedRange(MultiBufferBlockId id) {
-  pinned_range_ = std::make_pair(std::max(id - kMaxLookAheadIndex, 0),
-                                 id + kMaxLookBehindIndex);
-  LOG(INFO) << "!!!! id=" << id << " range=" << pinned_range_.first << "-"
-            << pinned_range_.second;
+void ResourceMultiBuffer::DropFetcher(int id) {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
+  fetchers_.erase(id);
 }
 
-void ResourceMultiBuffer::PurgeIfNecessary() {
-  while (lru_.Size() > kMaxCacheSize) {
-    MultiBufferBlockId id = lru_.Pop();
-    if (id >= pinned_range_.first && id <= pinned_range_.second)
-      lru_.Insert(id);
-    else {
-      auto it = cache_.find(id);
-      DCHECK(it != cache_.end());
-      LOG(INFO) << " erase id=" << id;
-      cache_.erase(it);
-    }
+int ResourceMultiBuffer::FindFetcherId(ResourceFetcher* fetcher) const {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
+  for (const auto& entry : fetchers_) {
+    if (entry.second.get() == fetcher)
+      return entry.first;
   }
+  return 0;
 }
 
-void ResourceMultiBuffer::CreateFetcherFrom(int position) {
-  if (!io_task_runner_->BelongsToCurrentThread()) {
-    io_task_runner_->PostTask(
-        FROM_HERE, base::Bind(&ResourceMultiBuffer::CreateFetcherFrom,
-                              base::Unretained(this), position));
+void ResourceMultiBuffer::ScheduleRangeFetches() {
+  DCHECK(io_task_runner_->BelongsToCurrentThread());
+  base::AutoLock auto_lock(lock_);
+  range_schedule_pending_ = false;
+  if (stream_.finished || !range_supported_)
     return;
+  const int64_t block_size = 1 << block_size_shift_;
+  const int64_t range_size =
+      std::max(block_size, options_.fetch_range_size / block_size * block_size);
+  int64_t total_bytes = cache_->GetTotalBytes();
+  int64_t first_range = playhead_ / range_size * range_size;
+  int64_t window_end = first_range + range_size;
+  // Until a response told the size only the range of the reader is known
+  // to exist.
+  if (total_bytes >= 0) {
+    window_end = std::min(first_range + GetRangeWindow(), total_bytes);
   }
-  fetcher_ = net::URLFetcher::Create(url_, net::URLFetcher::GET, this);
-  fetcher_->SetRequestContext(new net::TrivialURLRequestContextGetter(
-      g_request_context_init.Pointer()->request_context(), io_task_runner_));
-  std::unique_ptr<net::URLFetcherResponseWriter> response_writer =
-      base::MakeUnique<URLFetcherResponseWriterBridge>(this);
-  fetcher_->SetExtraRequestHeaders(
-      "Accept-Encoding: identity;q=1, *;q=0\r\nUser-Agent:Mozilla/5.0 (X11; "
-      "Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
-      "Chrome/59.0.3071.115 Safari/537.36\r\n");
-  fetcher_->SaveResponseWithWriter(std::move(response_writer));
-  std::stringstream range_header;
-  range_header << "Range: "
-               << "bytes=" << position << "-";
-  LOG(INFO) << "CreateFetcherFrom range=" << range_header.str();
-  fetcher_->AddExtraRequestHeader(range_header.str());
-  fetcher_->Start();
+  for (auto it = range_fetchers_.begin(); it != range_fetchers_.end();) {
+    if ((*it)->last() < first_range || (*it)->first() >= window_end) {
+      LOG(INFO) << "Cancel range " << (*it)->first() << "-" << (*it)->last();
+      it = range_fetchers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  // Ranges nearest to the reader first.
+  for (int64_t start = first_range;
+       start < window_end &&
+       static_cast<int>(range_fetchers_.size()) < options_.parallel_fetchers;
+       start += range_size) {
+    int64_t end = std::min(start + range_size, window_end);
+    bool in_flight = false;
+    for (const auto& range_fetcher : range_fetchers_) {
+      if (range_fetcher->first() >= start && range_fetcher->first() < end)
+        in_flight = true;
+    }
+    if (in_flight)
+      continue;
+    int64_t from = cache_->GetAvailableEnd(start);
+    if (from >= end)
+      continue;
+    range_fetchers_.push_back(base::MakeUnique<ResourceFetcher>(
+        this, url_, from, end - 1, io_task_runner_));
+    range_fetchers_.back()->Start();
+  }
+  // Report the fetch nearest to the reader, other players wait for it.
+  int64_t write_position = -1;
+  for (const auto& range_fetcher : range_fetchers_) {
+    if (write_position < 0 || range_fetcher->position() < write_position)
+      write_position = range_fetcher->position();
+  }
+  cache_->SetWriterPosition(this, write_position);
+}
+
+int64_t ResourceMultiBuffer::GetRangeWindow() const {
+  return options_.fetch_range_size * options_.parallel_fetchers *
+         kRangesAheadPerFetcher;
 }
 
 }  // namespace media
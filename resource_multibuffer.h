@@ -5,78 +5,189 @@
 
 #include "base/single_thread_task_runner.h"
 #include "base/synchronization/lock.h"
-#include "chromium_media_lib/lru.h"
-#include "media/base/data_buffer.h"
-#include "net/base/completion_callback.h"
-#include "net/base/io_buffer.h"
-#include "net/url_request/url_fetcher_delegate.h"
+#include "chromium_media_lib/resource_block_cache.h"
+#include "chromium_media_lib/resource_fetcher.h"
 #include "url/gurl.h"
 
 #include <map>
 #include <memory>
-#include <utility>
+#include <vector>
 
-namespace media {
+namespace base {
+class WaitableEvent;
+}
 
-typedef int32_t MultiBufferBlockId;
+namespace media {
 
+// Called on the IO thread and from cache notifications with locks of the
+// ResourceMultiBuffer held, must not lock or call back into it.
 class ResourceMultiBufferClient {
  public:
   virtual void DidInitialize() = 0;
   virtual void OnUpdateState() = 0;
 };
 
-// Use URLFetcher to buffer network resource.
-class ResourceMultiBuffer : public net::URLFetcherDelegate {
+// Use URLFetcher to buffer network resource. The blocks live in the
+// ResourceBlockCache of the URL, shared with other players of it.
+class ResourceMultiBuffer : public ResourceFetcher::Delegate,
+                            public ResourceBlockCache::Client {
  public:
+  struct Options {
+    Options();
+
+    // Number of bounded range requests fetching ahead of the reader at
+    // once, nearest to the reader first. Spreads the download over several
+    // connections so that one stalled connection doesn't stall playback.
+    // 0 keeps a single open-ended request following the reader.
+    int parallel_fetchers;
+    // Bytes fetched by each bounded range request. Rounded to blocks.
+    int64_t fetch_range_size;
+    // Seconds of media ahead of the reader kept pinned in the cache once
+    // SetBitrate() reported the bitrate. 0 keeps the fixed defaults.
+    int buffer_seconds;
+    // How the cache picks the blocks it drops once over budget. Players of
+    // the same URL share the cache, the first one picks the policy and
+    // the choice of later ones is ignored.
+    ResourceEvictionPolicy::Type eviction_policy;
+  };
+
   ResourceMultiBuffer(
       ResourceMultiBufferClient* client,
       const GURL& url,
       int32_t block_size_shift,
-      const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner);
+      const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner,
+      const Options& options);
   ~ResourceMultiBuffer() override;
 
-  MultiBufferBlockId ToBlockId(int position);
+  MultiBufferBlockId ToBlockId(int64_t position);
 
   int64_t GetSize();
+  // True once a server answered a range request with the whole resource.
+  // Seeks are served from what was buffered, the resource is only fetched
+  // again from the start if the data was dropped meanwhile.
+  bool IsStreaming();
   void Start();
-  void Seek(int position);
+  // No more OnUpdateState() once this returns. Called before |client_| goes
+  // away.
+  void Detach();
+  // Sizes the pinned range and the distance the current fetch is waited
+  // for from |bitrate|, in bits per second. May be called at any time.
+  void SetBitrate(int bitrate);
+  void Seek(int64_t position);
   // Try to fill data into |data|, and return write bytes or
   // net::ERR_IO_PENDINGO if no data available now.
-  int Fill(int position, int size, void* data);
+  int Fill(int64_t position, int size, void* data);
+  // Asks for one OnUpdateState() once data at |position| was written, so
+  // the notification is not repeated for every network chunk. Returns false
+  // without arming if the data is already there, or if a writer went away
+  // or a disk load failed while no reader waited, so that the reader
+  // retries and fetches the data itself.
+  bool NotifyWhenAvailable(int64_t position);
 
-  // net::URLFetcherDelegate
-  void OnURLFetchComplete(const net::URLFetcher* source) override;
+  // ResourceFetcher::Delegate
+  void OnFetcherStarted(ResourceFetcher* fetcher) override;
+  void OnFetcherWrite(ResourceFetcher* fetcher,
+                      int64_t position,
+                      const uint8_t* data,
+                      int size) override;
+  void OnFetcherDone(ResourceFetcher* fetcher, int net_error) override;
 
-  // Invoked by URLFetcherResponseWriter
-  void DidInitialize();
-  int OnWrite(net::IOBuffer* buffer,
-              int num_bytes,
-              const net::CompletionCallback& callback);
-  int OnFinish(int net_error, const net::CompletionCallback& callback);
+  // ResourceBlockCache::Client
+  void OnBlocksWritten(int64_t start, int64_t end) override;
+  void OnWriterRemoved() override;
 
  private:
   void AdjustPinnedRange(MultiBufferBlockId id);
-  void CreateFetcherFrom(int position);
-  void PurgeIfNecessary();
-  bool CheckCacheMiss(int position);
+  // First byte of block |id|.
+  int64_t ToPosition(MultiBufferBlockId id) const;
+  // A single open-ended request, the single mode keeps the one following
+  // the reader and the one it replaced.
+  struct Stream {
+    Stream();
+
+    // 0 if none.
+    int id;
+    int64_t start;
+    // Position of the next byte written.
+    int64_t position;
+    // Completed, failed or stopped, it won't write anything more.
+    bool finished;
+    int error;
+  };
+
+  // The current stream reaches |position| soon without a new request.
+  // |lock_| must be held.
+  bool IsNear(const Stream& stream, int64_t position) const;
+  // Opens a new stream at |position|. The current one drains the bytes on
+  // the wire meanwhile, in case the reader comes back. |lock_| must be held.
+  void StartStream(int64_t position);
+  // Leaves the data ahead to the fetch of another player. |lock_| must be
+  // held.
+  void StopStream();
+  // |lock_| must be held.
+  void StopDraining();
+  // Run on the IO thread.
+  void CreateFetcher(int id, int64_t position);
+  void DropFetcher(int id);
+  // Destroys the fetchers, then signals |done| unless null.
+  void ShutdownOnIOThread(base::WaitableEvent* done);
+  int FindFetcherId(ResourceFetcher* fetcher) const;
+  // Takes the size of the resource from the response headers of |fetcher|.
+  void UpdateTotalBytes(ResourceFetcher* fetcher);
+  // |fetcher| got the whole resource for a range request. It becomes the
+  // only stream, other requests would download everything again.
+  void OnRangesUnsupported(ResourceFetcher* fetcher);
+  // Parallel range requests are configured and the server supports them.
+  // Called on the IO thread or with |lock_| held.
+  bool UsesRangeFetches() const;
+  // Starts range requests for the missing ranges nearest to |playhead_|
+  // and cancels those the reader moved away from. Parallel mode only.
+  void ScheduleRangeFetches();
+  // Bytes ahead of the reader the range requests cover.
+  int64_t GetRangeWindow() const;
+  // Runs client_->OnUpdateState() unless detached.
+  void NotifyClient();
 
  private:
   GURL url_;
   const scoped_refptr<base::SingleThreadTaskRunner> io_task_runner_;
-  int write_start_pos_;
-  int write_offset_;
-  int64_t total_bytes_;
-  ResourceMultiBufferClient* client_;
-  std::unique_ptr<net::URLFetcher> fetcher_;
+  const Options options_;
+  bool started_;
+  // Position of the last Seek().
+  int64_t playhead_;
+  // In parallel mode only |finished| and |error| of |stream_| are used, set
+  // once range requests failed repeatedly.
+  Stream stream_;
+  Stream draining_;
+  // |draining_| is stopped once it wrote up to here.
+  int64_t drain_end_;
+  int next_stream_id_;
+  int range_failures_;
+  bool range_schedule_pending_;
+  // Written on the IO thread with |lock_| held.
+  bool range_supported_;
+  // Blocks pinned around the reader, and how far ahead of the current fetch
+  // a reader may be and still wait for it rather than start a new one.
+  // Follow the bitrate.
+  int64_t look_behind_blocks_;
+  int64_t look_ahead_blocks_;
+  int64_t wait_for_reader_bytes_;
   base::Lock lock_;
   int32_t block_size_shift_;
+  ResourceBlockCache* cache_;
+
+  // Guards |client_| and |wait_position_|. Taken from cache notifications,
+  // so nothing else may be locked under it.
+  base::Lock wait_lock_;
+  ResourceMultiBufferClient* client_;
+  // Position a reader waits for, -1 if none.
+  int64_t wait_position_;
+  // OnWriterRemoved() came while no reader waited.
+  bool writer_removed_;
 
-  // cache relative
-  std::map<MultiBufferBlockId, scoped_refptr<DataBuffer>> cache_;
-  LRU<MultiBufferBlockId> lru_;
-  // region which should not be pruned by LRU
-  std::pair<MultiBufferBlockId, MultiBufferBlockId> pinned_range_;
+  // Only used on the IO thread. Fetchers of |stream_| and |draining_| by id.
+  std::map<int, std::unique_ptr<ResourceFetcher>> fetchers_;
+  std::vector<std::unique_ptr<ResourceFetcher>> range_fetchers_;
 };
 }
 
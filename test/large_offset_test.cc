@@ -0,0 +1,319 @@
+// Copyright (c) 2017 YuTeh Shen
+//
+// Reads a sparse file of more than 4 GB at offsets around 2 GB and 4 GB,
+// through every FileDataSource backend and through ResourceDataSource from
+// a local HTTP server with range support, in the single stream and the
+// parallel range fetch mode. Exits with 1 if a read returned wrong data.
+//
+// Usage: ./large_offset_test [--dir=<directory of the sparse file>]
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/memory/ptr_util.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/task_scheduler/task_scheduler.h"
+#include "base/threading/thread.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "chromium_media_lib/file_data_source.h"
+#include "chromium_media_lib/media_context.h"
+#include "chromium_media_lib/resource_data_source.h"
+#include "net/http/http_byte_range.h"
+#include "net/http/http_status_code.h"
+#include "net/http/http_util.h"
+#include "net/test/embedded_test_server/embedded_test_server.h"
+#include "net/test/embedded_test_server/http_request.h"
+#include "net/test/embedded_test_server/http_response.h"
+#include "url/gurl.h"
+
+namespace {
+
+const int64_t kTwoGB = int64_t{1} << 31;
+const int64_t kFourGB = int64_t{1} << 32;
+const int64_t kFileSize = 5 * (int64_t{1} << 30) + 123;
+// Markers are written at these offsets, the rest of the file is a hole.
+// Some straddle the 2 GB and 4 GB boundaries.
+const int64_t kMarkerOffsets[] = {
+    0,
+    kTwoGB - 8,
+    kTwoGB + 40000,
+    kFourGB - 8,
+    kFourGB + 7 * 4096 + 3,
+    kFileSize - 16,
+};
+const int kMarkerSize = 16;
+// Longest body the test server sends, a shorter 206 than asked for is
+// legal and keeps open-ended requests from streaming gigabytes.
+const int64_t kMaxResponseBytes = 1024 * 1024;
+
+// Bytes of the marker at |offset|, different for every offset.
+std::string MakeMarker(int64_t offset) {
+  std::string marker(kMarkerSize, 0);
+  for (int i = 0; i < kMarkerSize; ++i)
+    marker[i] = static_cast<char>((offset >> (8 * (i % 8))) ^ (i * 37));
+  return marker;
+}
+
+bool CreateSparseFile(const base::FilePath& path) {
+  base::File file(path, base::File::FLAG_CREATE_ALWAYS |
+                            base::File::FLAG_WRITE);
+  if (!file.IsValid() || !file.SetLength(kFileSize))
+    return false;
+  for (int64_t offset : kMarkerOffsets) {
+    std::string marker = MakeMarker(offset);
+    if (file.Write(offset, marker.data(), kMarkerSize) != kMarkerSize)
+      return false;
+  }
+  return true;
+}
+
+// Serves |path| at /large, honouring single byte ranges.
+std::unique_ptr<net::test_server::HttpResponse> HandleRequest(
+    const base::FilePath& path,
+    const net::test_server::HttpRequest& request) {
+  if (request.GetURL().path() != "/large")
+    return nullptr;
+  auto response = base::MakeUnique<net::test_server::BasicHttpResponse>();
+  response->AddCustomHeader("Accept-Ranges", "bytes");
+  response->set_content_type("application/octet-stream");
+  std::vector<net::HttpByteRange> ranges;
+  auto range_header = request.headers.find("Range");
+  if (range_header == request.headers.end() ||
+      !net::HttpUtil::ParseRangeHeader(range_header->second, &ranges) ||
+      ranges.size() != 1 || !ranges[0].ComputeBounds(kFileSize)) {
+    response->set_code(net::HTTP_REQUESTED_RANGE_NOT_SATISFIABLE);
+    response->AddCustomHeader(
+        "Content-Range", base::StringPrintf("bytes */%" PRId64, kFileSize));
+    return std::move(response);
+  }
+  const int64_t first = ranges[0].first_byte_position();
+  const int64_t last = std::min(ranges[0].last_byte_position(),
+                                first + kMaxResponseBytes - 1);
+  std::string content(static_cast<size_t>(last - first + 1), 0);
+  base::File file(path, base::File::FLAG_OPEN | base::File::FLAG_READ);
+  if (file.Read(first, &content[0], static_cast<int>(content.size())) !=
+      static_cast<int>(content.size())) {
+    response->set_code(net::HTTP_INTERNAL_SERVER_ERROR);
+    return std::move(response);
+  }
+  response->set_code(net::HTTP_PARTIAL_CONTENT);
+  response->AddCustomHeader(
+      "Content-Range", base::StringPrintf("bytes %" PRId64 "-%" PRId64
+                                          "/%" PRId64,
+                                          first, last, kFileSize));
+  response->set_content(content);
+  return std::move(response);
+}
+
+void OnInitialized(const scoped_refptr<base::SingleThreadTaskRunner>& loop,
+                   const base::Closure& quit,
+                   bool* success_out,
+                   bool success) {
+  *success_out = success;
+  loop->PostTask(FROM_HERE, quit);
+}
+
+void OnRead(const scoped_refptr<base::SingleThreadTaskRunner>& loop,
+            const base::Closure& quit,
+            int* result_out,
+            int result) {
+  *result_out = result;
+  loop->PostTask(FROM_HERE, quit);
+}
+
+template <typename Source>
+bool Initialize(Source* source) {
+  base::RunLoop run_loop;
+  bool success = false;
+  source->Initialize(base::Bind(&OnInitialized,
+                                base::ThreadTaskRunnerHandle::Get(),
+                                run_loop.QuitClosure(), &success));
+  run_loop.Run();
+  return success;
+}
+
+// Reads on the calling thread's loop, completions may come from any
+// thread.
+int ReadAt(media::DataSource* source, int64_t position, int size,
+           uint8_t* data) {
+  base::RunLoop run_loop;
+  int result = media::DataSource::kReadError;
+  source->Read(position, size, data,
+               base::Bind(&OnRead, base::ThreadTaskRunnerHandle::Get(),
+                          run_loop.QuitClosure(), &result));
+  run_loop.Run();
+  return result;
+}
+
+// Reads may return less than asked for, e.g. up to the end of a block of
+// the HTTP cache. Returns the bytes read, or the first error.
+int ReadFully(media::DataSource* source, int64_t position, int size,
+              uint8_t* data) {
+  int done = 0;
+  while (done < size) {
+    int result = ReadAt(source, position + done, size - done, data + done);
+    if (result < 0)
+      return result;
+    if (!result)
+      break;
+    done += result;
+  }
+  return done;
+}
+
+// Reads every marker through |source|, and the end of the file if
+// |check_end|. Returns the number of failed checks.
+int CheckSource(const std::string& name,
+                media::DataSource* source,
+                bool check_end) {
+  int failures = 0;
+  int64_t size = 0;
+  if (!source->GetSize(&size) || size != kFileSize) {
+    LOG(ERROR) << name << ": size " << size << ", expected " << kFileSize;
+    ++failures;
+  }
+  // Backwards, so that every read seeks.
+  for (int i = static_cast<int>(arraysize(kMarkerOffsets)) - 1; i >= 0;
+       --i) {
+    const int64_t offset = kMarkerOffsets[i];
+    uint8_t data[kMarkerSize];
+    int result = ReadFully(source, offset, kMarkerSize, data);
+    if (result != kMarkerSize ||
+        std::string(reinterpret_cast<char*>(data), kMarkerSize) !=
+            MakeMarker(offset)) {
+      LOG(ERROR) << name << ": read at " << offset << " returned " << result;
+      ++failures;
+    }
+  }
+  if (check_end) {
+    uint8_t data[kMarkerSize];
+    int result = ReadAt(source, kFileSize, kMarkerSize, data);
+    if (result != 0) {
+      LOG(ERROR) << name << ": read at the end returned " << result;
+      ++failures;
+    }
+  }
+  LOG(INFO) << name << (failures ? ": FAILED" : ": passed");
+  return failures;
+}
+
+int CheckFileDataSource(
+    const base::FilePath& path,
+    media::FileDataSource::Options::Backend backend,
+    const std::string& name,
+    const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner) {
+  media::FileDataSource::Options options;
+  options.backend = backend;
+  media::FileDataSource source(path, base::ThreadTaskRunnerHandle::Get(),
+                               io_task_runner, options);
+  if (!Initialize(&source)) {
+    // E.g. O_DIRECT on tmpfs.
+    if (backend == media::FileDataSource::Options::kDirectIO) {
+      LOG(WARNING) << name << ": skipped, can't open the file";
+      return 0;
+    }
+    LOG(ERROR) << name << ": initialization failed";
+    return 1;
+  }
+  int failures = CheckSource(name, &source, false);
+  source.Stop();
+  return failures;
+}
+
+int CheckResourceDataSource(
+    const GURL& url,
+    int parallel_fetchers,
+    const std::string& name,
+    const scoped_refptr<base::SingleThreadTaskRunner>& io_task_runner) {
+  media::ResourceMultiBuffer::Options options;
+  options.parallel_fetchers = parallel_fetchers;
+  media::ResourceDataSource source(url, base::ThreadTaskRunnerHandle::Get(),
+                                   io_task_runner, options);
+  if (!Initialize(&source)) {
+    LOG(ERROR) << name << ": initialization failed";
+    return 1;
+  }
+  // Past the end a read completes with 0 bytes once the size is known
+  // from the response headers.
+  int failures = CheckSource(name, &source, true);
+  source.Stop();
+  return failures;
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+  base::AtExitManager at_exit;
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* command_line = base::CommandLine::ForCurrentProcess();
+
+  base::MessageLoopForIO message_loop;
+  base::TaskScheduler::Create("large_offset_test");
+  base::TaskScheduler::GetInstance()->Start(
+      *media::MediaContext::Get()->GetDefaultTaskSchedulerInitParams());
+  base::Thread io_thread("IO");
+  io_thread.StartWithOptions(
+      base::Thread::Options(base::MessageLoop::TYPE_IO, 0));
+
+  // The file is sparse, it takes a few blocks of disk space.
+  base::ScopedTempDir temp_dir;
+  bool created = command_line->HasSwitch("dir")
+                     ? temp_dir.CreateUniqueTempDirUnderPath(
+                           command_line->GetSwitchValuePath("dir"))
+                     : temp_dir.CreateUniqueTempDir();
+  base::FilePath path = temp_dir.GetPath().AppendASCII("large");
+  if (!created || !CreateSparseFile(path)) {
+    LOG(ERROR) << "Can't create the sparse file";
+    return 1;
+  }
+
+  int failures = 0;
+  failures += CheckFileDataSource(
+      path, media::FileDataSource::Options::kMemoryMapped, "mmap",
+      io_thread.task_runner());
+  failures += CheckFileDataSource(
+      path, media::FileDataSource::Options::kPositionedRead, "pread",
+      io_thread.task_runner());
+  failures += CheckFileDataSource(
+      path, media::FileDataSource::Options::kDirectIO, "direct",
+      io_thread.task_runner());
+
+  net::EmbeddedTestServer test_server;
+  test_server.RegisterRequestHandler(base::Bind(&HandleRequest, path));
+  if (!test_server.Start()) {
+    LOG(ERROR) << "Can't start the test server";
+    return 1;
+  }
+  // Other URLs, so that the two modes don't share cached blocks.
+  failures += CheckResourceDataSource(test_server.GetURL("/large?single"), 0,
+                                      "http", io_thread.task_runner());
+  failures += CheckResourceDataSource(test_server.GetURL("/large?parallel"),
+                                      2, "http parallel",
+                                      io_thread.task_runner());
+
+  io_thread.Stop();
+  base::TaskScheduler::GetInstance()->Shutdown();
+  if (failures) {
+    LOG(ERROR) << failures << " checks failed";
+    return 1;
+  }
+  LOG(INFO) << "All checks passed";
+  return 0;
+}